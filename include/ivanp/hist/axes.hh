@@ -3,9 +3,19 @@
 
 #include <type_traits>
 #include <limits>
+#include <cmath>
 #include <algorithm>
 #include <iterator>
 #include <variant>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <utility>
+#include <stdexcept>
+#include <span>
+#include <bit>
+#include <cstdint>
 
 #include <ivanp/cont/general.hh>
 #include <ivanp/cont/map.hh>
@@ -20,6 +30,119 @@ using index_type = IVANP_HIST_INDEX_TYPE;
 template <typename Edge>
 class uniform_axis;
 
+// Bins added to an axis by grow()
+// The first (underflow) bin stays in place, and the below bins follow it.
+// The above bins are inserted before the last (overflow) bin,
+// or appended if the axis has no overflow bin.
+struct axis_growth {
+  index_type below = 0, above = 0;
+  bool overflow = true;
+
+  explicit operator bool() const noexcept { return below || above; }
+
+  // new index of bin i of an axis that had n bins
+  index_type operator()(index_type i, index_type n) const noexcept {
+    if (i == 0) return 0;
+    if (overflow && i+1 == n) return i+below+above;
+    return i+below;
+  }
+};
+
+namespace detail {
+
+// log2 from the exponent bits and an atanh series for the mantissa
+// Absolute error is below 2e-9 for positive normal x.
+// There are no branches, so loops calling this vectorize.
+[[gnu::always_inline]]
+inline double fast_log2(double x) noexcept {
+  // shift the mantissa range to [sqrt(1/2),sqrt(2)) with integer ops
+  constexpr std::uint64_t sqrt_half = 0x3FE6'A09E'667F'3BCDull;
+  const auto bits = std::bit_cast<std::uint64_t>(x)
+                  + (0x3FF0'0000'0000'0000ull - sqrt_half);
+  const double m = std::bit_cast<double>(
+    (bits & 0x000F'FFFF'FFFF'FFFFull) + sqrt_half );
+  // exponent converted to double with the 2^52 trick
+  const double e =
+    std::bit_cast<double>( (bits >> 52) | 0x4330'0000'0000'0000ull )
+    - (4503599627370496. + 1023);
+  // ln(m) = 2 atanh(u)
+  const double u = (m-1)/(m+1), u2 = u*u;
+  const double ln = 2*u*(1 + u2*(1./3 + u2*(1./5 + u2*(1./7 + u2*(1./9)))));
+  return e + ln*1.4426950408889634; // log2(e)
+}
+
+// sqrt by Newton iterations for 1/sqrt(x), without errno checks
+// Relative error is below 1e-15 for positive normal x, and sqrt(0) is 0.
+[[gnu::always_inline]]
+inline double fast_sqrt(double x) noexcept {
+  double y = std::bit_cast<double>(
+    0x5FE6'EB50'C7B5'37A9ull - (std::bit_cast<std::uint64_t>(x) >> 1) );
+  const double h = 0.5*x;
+  y *= 1.5 - h*y*y;
+  y *= 1.5 - h*y*y;
+  y *= 1.5 - h*y*y;
+  y *= 1.5 - h*y*y;
+  return x*y;
+}
+
+// x < e without rounding either value
+template <typename T, typename E>
+[[gnu::always_inline]]
+constexpr bool less(T x, E e) noexcept {
+  if constexpr (std::is_integral_v<T> && std::is_integral_v<E>)
+    return std::cmp_less(x,e);
+  else
+    return x < e;
+}
+
+// floor(a*b/c) for a < c, without overflowing the product
+[[gnu::always_inline]]
+constexpr std::uint64_t mul_div(
+  std::uint64_t a, std::uint64_t b, std::uint64_t c
+) noexcept {
+#ifdef __SIZEOF_INT128__
+  return std::uint64_t( (unsigned __int128)(a)*b/c );
+#else
+  if (b == 0 || a <= std::numeric_limits<std::uint64_t>::max()/b)
+    return a*b/c;
+  // without a 128 bit type, round through long double; a < c, so q < b
+  const std::uint64_t q = std::uint64_t((long double)(a)/c*b);
+  return q < b ? q : b-1;
+#endif
+}
+
+// largest float not greater than x
+// Comparisons with float edges give the same results for the two values.
+[[gnu::always_inline]]
+inline float float_below(double x) noexcept {
+  const float f = float(x);
+  const auto b = std::bit_cast<std::int32_t>(f);
+  // step one ulp toward -inf; -0 steps to the smallest negative denormal
+  return std::bit_cast<float>( b + ( double(f) > x ? (b < 0 ? 1 : -1) : 0 ) );
+}
+
+// Bin index of x on an axis with ndiv bins between min and max,
+// given its approximate position t in units of bins.
+// Within tol of a bin boundary, x is compared to the exact edges.
+template <typename Axis, typename T>
+index_type correct_bin_index(
+  const Axis& a, T x, double t, double tol
+) noexcept {
+  if (x < a.min()) return 0;
+  const index_type ndiv = a.ndiv();
+  if (!(x < a.max())) return ndiv+1;
+  index_type i = t > 0 ? index_type(t) : 0;
+  if (i >= ndiv) i = ndiv-1;
+  const double frac = t - i;
+  if (frac < tol || frac > 1-tol) {
+    while (i > 0 && x < a.edge(i)) --i;
+    while (i+1 < ndiv && !(x < a.edge(i+1))) ++i;
+  }
+  return i+1;
+}
+
+} // end namespace detail
+
 // Container axis ===================================================
 template <
   typename Cont = std::vector<double>,
@@ -118,6 +241,118 @@ public:
     return find_bin_index(x);
   }
 
+  // coordinate of a different type is compared to edges exactly,
+  // e.g. a double is not rounded to a float edge_type
+  template <typename T>
+  requires (std::is_arithmetic_v<T> && !std::is_same_v<T,edge_type>)
+  index_type find_bin_index(T x) const noexcept {
+    using namespace std;
+    return distance( begin(_edges), upper_bound(begin(_edges), end(_edges),
+      x, [](T x, const auto& e){ return detail::less(x,e); }) );
+  }
+  template <typename T>
+  requires (std::is_arithmetic_v<T> && !std::is_same_v<T,edge_type>)
+  index_type operator()(T x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  // Exponential search outward from a hint, e.g. the previous bin index,
+  // followed by a binary search in the bracketed range.
+  // Takes O(log d) comparisons for a bin d bins away from the hint.
+  template <typename T>
+  index_type find_bin_index(const T& x, index_type hint) const noexcept {
+    using namespace std;
+    const auto e = begin(_edges);
+    const index_type ne = nedges();
+    if (hint > ne) hint = ne;
+    const auto cmp = [](const T& x, const auto& e){
+      return detail::less(x,e);
+    };
+    if (hint < ne && !detail::less(x,e[hint])) { // gallop up
+      index_type lo = hint+1, step = 1;
+      while (lo+step <= ne && !detail::less(x,e[lo+step-1])) {
+        lo += step;
+        step *= 2;
+      }
+      const index_type hi = std::min(lo+step-1,ne);
+      return distance(e, upper_bound(e+lo, e+hi, x, cmp));
+    }
+    if (hint > 0 && detail::less(x,e[hint-1])) { // gallop down
+      index_type hi = hint-1, step = 1;
+      while (hi >= step && detail::less(x,e[hi-step])) {
+        hi -= step;
+        step *= 2;
+      }
+      const index_type lo = hi >= step ? hi-step+1 : 0;
+      return distance(e, upper_bound(e+lo, e+hi, x, cmp));
+    }
+    return hint;
+  }
+
+  // Merges coordinates in ascending order with the edges,
+  // in O(n + nedges) time, by searching from the previous bin index.
+  // Unsorted coordinates still get the correct indices.
+  template <typename T>
+  void find_sorted_bin_indices(
+    std::span<const T> xs, std::span<index_type> out, index_type hint = 0
+  ) const noexcept {
+    for (size_t i=0, n=std::min(xs.size(),out.size()); i<n; ++i)
+      out[i] = hint = find_bin_index(xs[i],hint);
+  }
+
+  // Branchless binary search over a group of coordinates in lockstep.
+  // The search path length only depends on the number of edges,
+  // so the lookups are independent and their loads overlap.
+  // Doubles on float edges are rounded down to float first,
+  // which does not change the result.
+  template <typename T>
+  void find_bin_indices(
+    std::span<const T> xs, std::span<index_type> out
+  ) const noexcept {
+    const size_t n = std::min(xs.size(),out.size());
+    if constexpr (
+      std::is_same_v<edge_type,float> && std::is_same_v<T,double>
+    ) {
+      constexpr size_t chunk = 256;
+      float xf[chunk];
+      for (size_t k=0; k<n; k+=chunk) {
+        const size_t m = std::min(chunk,n-k);
+        for (size_t i=0; i<m; ++i) // vectorized
+          xf[i] = detail::float_below(xs[k+i]);
+        find_bin_indices(
+          std::span<const float>(xf,m), out.subspan(k,m) );
+      }
+    } else if constexpr (
+      std::is_arithmetic_v<T> && std::is_arithmetic_v<edge_type> &&
+      requires { std::data(_edges); }
+    ) {
+      const edge_type* const e = std::data(_edges);
+      const index_type ne = nedges();
+      if (ne == 0) {
+        std::fill(out.begin(),out.begin()+n,0);
+        return;
+      }
+      constexpr size_t lanes = 16;
+      for (size_t k=0; k<n; k+=lanes) {
+        const size_t m = std::min(lanes,n-k);
+        T x[lanes] { };
+        index_type pos[lanes] { };
+        std::copy_n(xs.data()+k,m,x);
+        for (index_type len = ne; len > 1; ) {
+          const index_type half = len/2;
+          for (size_t j=0; j<lanes; ++j)
+            pos[j] += detail::less(x[j],e[pos[j]+half]) ? 0 : half;
+          len -= half;
+        }
+        for (size_t j=0; j<m; ++j)
+          out[k+j] = pos[j] + !detail::less(x[j],e[pos[j]]);
+      }
+    } else {
+      for (size_t i=0; i<n; ++i)
+        out[i] = find_bin_index(xs[i]);
+    }
+  }
+
   cont_type& edges() noexcept { return _edges; }
   const cont_type& edges() const noexcept { return _edges; }
 
@@ -199,14 +434,802 @@ public:
     return edge(i);
   }
 
-  constexpr index_type find_bin_index(edge_type x) const noexcept {
+private:
+  // type in which the position of a coordinate of type T is computed
+  // Doubles are not rounded to float edges, and integers use exact math.
+  template <typename T>
+  using calc_type = std::conditional_t<
+    std::is_integral_v<T> && std::is_integral_v<edge_type>, void,
+    std::conditional_t< std::is_same_v<T,edge_type>, edge_type,
+      std::common_type_t<T,edge_type,double> > >;
+
+public:
+  template <typename T = edge_type>
+  requires std::is_arithmetic_v<T>
+  constexpr index_type find_bin_index(T x) const noexcept {
+    if (detail::less(x,_min)) return 0;
+    if (!detail::less(x,_max)) return _ndiv+1;
+    if constexpr (std::is_void_v<calc_type<T>>) {
+      using U = std::make_unsigned_t<std::common_type_t<T,edge_type>>;
+      const U d = U(x)-U(_min), range = U(_max)-U(_min);
+      if constexpr (sizeof(U) <= 4 && sizeof(index_type) <= 4)
+        return index_type( std::uint64_t(d)*_ndiv / range ) + 1;
+      else // the 64 bit product can overflow
+        return index_type( detail::mul_div(d,_ndiv,range) ) + 1;
+    } else {
+      using C = calc_type<T>;
+      const index_type i = index_type(_ndiv*(C(x)-C(_min))/(C(_max)-C(_min)));
+      return (i < _ndiv ? i : _ndiv-1) + 1;
+    }
+  }
+  template <typename T = edge_type>
+  requires std::is_arithmetic_v<T>
+  constexpr index_type operator()(T x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  template <typename T>
+  void find_bin_indices(
+    std::span<const T> xs, std::span<index_type> out
+  ) const noexcept {
+    const size_t n = std::min(xs.size(),out.size());
+    using C = calc_type<T>;
+    if constexpr (
+      std::is_void_v<C> && sizeof(edge_type) <= 4 && sizeof(T) <= 4
+    ) {
+      // fixed point: reciprocal multiply with an exact integer correction
+      // Offsets below min wrap around to large unsigned values.
+      using U = std::uint32_t;
+      const edge_type min = _min;
+      const U range = U(_max)-U(_min), ndiv = _ndiv;
+      if (range == 0) { // every x is below min or not below max
+        for (size_t i=0; i<n; ++i)
+          out[i] = detail::less(xs[i],min) ? 0 : ndiv+1;
+        return;
+      }
+      const double scale = double(ndiv)/range;
+      for (size_t i=0; i<n; ++i) {
+        const T x = xs[i];
+        const U d = U(x) - U(min);
+        const std::uint64_t nd = std::uint64_t(d)*ndiv;
+        std::uint64_t q = std::uint64_t(double(d)*scale);
+        q -= q*range > nd;
+        q += (q+1)*range <= nd;
+        out[i] = d < range ? index_type(q)+1
+          : detail::less(x,min) ? 0 : ndiv+1;
+      }
+    } else if constexpr (std::is_void_v<C>) {
+      for (size_t i=0; i<n; ++i)
+        out[i] = find_bin_index(xs[i]);
+    } else {
+      // branchless form of find_bin_index() that vectorizes
+      const C min = _min, max = _max, d = max - min,
+        under = -1, over = _ndiv, last = over - 1;
+      for (size_t i=0; i<n; ++i) {
+        const C x = xs[i], t = over*(x-min)/d;
+        const C tc = std::isless(t,last) ? t : last;
+        const C y = std::isless(x,max) ? tc : over;
+        // signed conversion vectorizes without AVX-512
+        out[i] = index_type(
+          std::make_signed_t<index_type>(std::isless(x,min) ? under : y) + 1);
+      }
+    }
+  }
+};
+
+// Growable uniform axis ===========================================
+// Uniform axis with a fixed bin width that extends its range
+// when grow() is called with a finite value outside of it.
+// The range is extended by at least as many bins as it already has,
+// so a histogram with this axis rearranges its bins
+// only a logarithmic number of times.
+template <typename Edge = double>
+class growable_uniform_axis {
+  static_assert(std::is_floating_point_v<Edge>);
+public:
+  using edge_type = Edge;
+
+  static constexpr edge_type lowest = -std::numeric_limits<edge_type>::infinity();
+  static constexpr edge_type highest = std::numeric_limits<edge_type>::infinity();
+
+private:
+  // edges are counted from the initial min, so that they do not drift
+  edge_type _origin, _width, _min, _max;
+  index_type _nlow, _ndiv; // bins added below origin, and all bins
+
+  edge_type edge_at(index_type i) const noexcept {
+    return _origin + (edge_type(i) - edge_type(_nlow))*_width;
+  }
+
+public:
+  growable_uniform_axis() noexcept = default;
+  growable_uniform_axis(const growable_uniform_axis&) noexcept = default;
+  growable_uniform_axis(growable_uniform_axis&&) noexcept = default;
+  growable_uniform_axis& operator=(const growable_uniform_axis&)
+    noexcept = default;
+  growable_uniform_axis& operator=(growable_uniform_axis&&)
+    noexcept = default;
+  ~growable_uniform_axis() = default;
+
+  growable_uniform_axis(edge_type min, edge_type max, index_type ndiv)
+  noexcept: _nlow(0), _ndiv(ndiv)
+  {
+    if (max < min) std::swap(min,max);
+    _origin = _min = min;
+    _width = (max - min)/ndiv;
+    _max = edge_at(_ndiv);
+  }
+
+  index_type nbins () const noexcept { return _ndiv+2; }
+  index_type ndiv  () const noexcept { return _ndiv  ; }
+  index_type nedges() const noexcept { return _ndiv+1; }
+
+  edge_type edge(index_type i) const noexcept { return edge_at(i); }
+  edge_type operator[](index_type i) const noexcept { return edge(i); }
+
+  edge_type min() const noexcept { return _min; }
+  edge_type max() const noexcept { return _max; }
+  edge_type width() const noexcept { return _width; }
+
+  edge_type lower(index_type i) const noexcept {
+    if (i==0) return lowest;
+    if (i > _ndiv+1) return highest;
+    return edge(i-1);
+  }
+  edge_type upper(index_type i) const noexcept {
+    if (i > _ndiv) return highest;
+    return edge(i);
+  }
+
+  index_type find_bin_index(edge_type x) const noexcept {
     if (x < _min) return 0;
     if (!(x < _max)) return _ndiv+1;
-    return index_type(_ndiv*(x-_min)/(_max-_min)) + 1;
+    const index_type i = index_type((x-_min)/_width);
+    return (i < _ndiv ? i : _ndiv-1) + 1;
+  }
+  index_type operator()(edge_type x) const noexcept {
+    return find_bin_index(x);
+  }
+
+private:
+  // number of bins to add to reach distance d past the range
+  index_type growth(edge_type d) const {
+    // room left for nbins() to fit in index_type
+    const index_type room = std::numeric_limits<index_type>::max()-2 - _ndiv;
+    const edge_type k = std::floor(d/_width) + 1;
+    if (!(k < edge_type(room)+1) || index_type(k) > room)
+      throw std::length_error(
+        "growable_uniform_axis number of bins overflows index_type");
+    return std::max(index_type(k), std::min(_ndiv,room));
+  }
+
+public:
+  // The axis is left unchanged if the number of bins would overflow.
+  axis_growth grow(edge_type x) {
+    if (!std::isfinite(x)) return { };
+    if (x < _min) {
+      const index_type n = growth(_min-x);
+      _nlow += n;
+      _ndiv += n;
+      _min = edge_at(0);
+      return { n, 0 };
+    }
+    if (!(x < _max)) {
+      const index_type n = growth(x-_max);
+      _ndiv += n;
+      _max = edge_at(_ndiv);
+      return { 0, n };
+    }
+    return { };
+  }
+};
+
+// Logarithmic uniform axis ========================================
+template <typename Edge = double>
+class log_uniform_axis {
+public:
+  using edge_type = Edge;
+
+  static constexpr edge_type lowest =
+    std::numeric_limits<edge_type>::has_infinity
+    ? -std::numeric_limits<edge_type>::infinity()
+    : std::numeric_limits<edge_type>::lowest();
+
+  static constexpr edge_type highest =
+    std::numeric_limits<edge_type>::has_infinity
+    ? std::numeric_limits<edge_type>::infinity()
+    : std::numeric_limits<edge_type>::max();
+
+private:
+  edge_type _min, _max;
+  index_type _ndiv;
+  // log2(min), bin width in log2, bins per unit of log2,
+  // and distance to bin boundary below which edges are checked exactly
+  double _lmin, _step, _scale, _tol;
+
+public:
+  log_uniform_axis() noexcept = default;
+  log_uniform_axis(const log_uniform_axis&) noexcept = default;
+  log_uniform_axis(log_uniform_axis&&) noexcept = default;
+  log_uniform_axis& operator=(const log_uniform_axis&) noexcept = default;
+  log_uniform_axis& operator=(log_uniform_axis&&) noexcept = default;
+  ~log_uniform_axis() = default;
+
+  log_uniform_axis(edge_type min, edge_type max, index_type ndiv)
+  : _min(min), _max(max), _ndiv(ndiv)
+  {
+    if (_max < _min) std::swap(_min,_max);
+    if (!(_min > 0)) throw std::domain_error(
+      "logarithmic axis requires positive edges");
+    _lmin = std::log2(double(_min));
+    _step = (std::log2(double(_max)) - _lmin)/_ndiv;
+    _scale = 1/_step;
+    _tol = (1e-8 + 1e-15*(std::abs(_lmin)+_ndiv*_step))*_scale;
+  }
+
+  index_type nbins () const noexcept { return _ndiv+2; }
+  index_type ndiv  () const noexcept { return _ndiv  ; }
+  index_type nedges() const noexcept { return _ndiv+1; }
+
+  edge_type edge(index_type i) const noexcept {
+    if (i == 0) return _min;
+    if (i >= _ndiv) return _max;
+    return edge_type(std::exp2(_lmin + i*_step));
+  }
+  edge_type operator[](index_type i) const noexcept { return edge(i); }
+
+  edge_type min() const noexcept { return _min; }
+  edge_type max() const noexcept { return _max; }
+
+  edge_type lower(index_type i) const noexcept {
+    if (i==0) return lowest;
+    if (i > _ndiv+1) return highest;
+    return edge(i-1);
+  }
+  edge_type upper(index_type i) const noexcept {
+    if (i > _ndiv) return highest;
+    return edge(i);
+  }
+
+  index_type find_bin_index(edge_type x) const noexcept {
+    return detail::correct_bin_index(
+      *this, x, (detail::fast_log2(x) - _lmin)*_scale, _tol);
+  }
+  index_type operator()(edge_type x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  void find_bin_indices(
+    std::span<const edge_type> xs, std::span<index_type> out
+  ) const noexcept {
+    const size_t n = std::min(xs.size(),out.size());
+    constexpr size_t chunk = 256;
+    double t[chunk];
+    const double lmin = _lmin, scale = _scale;
+    for (size_t k=0; k<n; k+=chunk) {
+      const size_t m = std::min(chunk,n-k);
+      const edge_type* x = xs.data()+k;
+      for (size_t i=0; i<m; ++i) // vectorized
+        t[i] = (detail::fast_log2(x[i]) - lmin)*scale;
+      for (size_t i=0; i<m; ++i)
+        out[k+i] = detail::correct_bin_index(*this,x[i],t[i],_tol);
+    }
+  }
+};
+
+// Transformed axis =================================================
+// Bins are uniform in Transform::forward(x).
+// A transform provides an increasing forward() and its inverse(),
+// and fast(), a branchless approximation of forward() with an error
+// below fast_error*max(1,|forward(x)|), used for the batch lookup.
+// Edges are computed with inverse(), and coordinates near bin boundaries
+// are compared to them exactly, so lookups agree with the edges.
+
+struct sqrt_transform {
+  static constexpr const char* name = "sqrt";
+  static constexpr double fast_error = 1e-15; // 2 ulp relative
+  static double forward(double x) noexcept { return std::sqrt(x); }
+  static double inverse(double y) noexcept { return y*y; }
+  static double fast(double x) noexcept { return detail::fast_sqrt(x); }
+  static bool domain(double x) noexcept { return x >= 0; }
+};
+
+// -1/x, which is increasing on either side of 0
+struct reciprocal_transform {
+  static constexpr const char* name = "reciprocal";
+  static constexpr double fast_error = 0;
+  static double forward(double x) noexcept { return -1/x; }
+  static double inverse(double y) noexcept { return -1/y; }
+  static double fast(double x) noexcept { return -1/x; }
+  static bool domain(double x) noexcept { return x != 0; }
+};
+
+struct asinh_transform {
+  static constexpr const char* name = "asinh";
+  static constexpr double fast_error = 2e-9;
+  static double forward(double x) noexcept { return std::asinh(x); }
+  static double inverse(double y) noexcept { return std::sinh(y); }
+  static double fast(double x) noexcept {
+    // asinh(a) = ln(a + sqrt(a^2+1)), and ln(2a) where a^2 overflows
+    const double a = std::abs(x);
+    const double b = a * std::isless(a,1e150); // no select, vectorizes
+    const double s = b + detail::fast_sqrt(b*b+1) + (a-b);
+    return std::copysign(
+      (detail::fast_log2(s) + (a != b))*0.6931471805599453, x);
+  }
+  static bool domain(double) noexcept { return true; }
+};
+
+template <typename Transform, typename Edge = double>
+class transformed_axis {
+public:
+  using edge_type = Edge;
+  using transform_type = Transform;
+
+  static constexpr edge_type lowest =
+    std::numeric_limits<edge_type>::has_infinity
+    ? -std::numeric_limits<edge_type>::infinity()
+    : std::numeric_limits<edge_type>::lowest();
+
+  static constexpr edge_type highest =
+    std::numeric_limits<edge_type>::has_infinity
+    ? std::numeric_limits<edge_type>::infinity()
+    : std::numeric_limits<edge_type>::max();
+
+private:
+  edge_type _min, _max;
+  index_type _ndiv;
+  // transformed min, bin width, bins per unit,
+  // and distance to bin boundary below which edges are checked exactly
+  double _tmin, _step, _scale, _tol;
+
+public:
+  transformed_axis() noexcept = default;
+  transformed_axis(const transformed_axis&) noexcept = default;
+  transformed_axis(transformed_axis&&) noexcept = default;
+  transformed_axis& operator=(const transformed_axis&) noexcept = default;
+  transformed_axis& operator=(transformed_axis&&) noexcept = default;
+  ~transformed_axis() = default;
+
+  transformed_axis(edge_type min, edge_type max, index_type ndiv)
+  : _min(min), _max(max), _ndiv(ndiv)
+  {
+    if (_max < _min) std::swap(_min,_max);
+    if (!( Transform::domain(_min) && Transform::domain(_max) &&
+           Transform::forward(_min) < Transform::forward(_max) ))
+      throw std::domain_error(std::string(
+        "axis range is outside of the domain of the ")
+        + Transform::name + " transform");
+    _tmin = Transform::forward(double(_min));
+    const double tmax = Transform::forward(double(_max));
+    _step = (tmax - _tmin)/_ndiv;
+    _scale = 1/_step;
+    const double tabs = std::max({ 1., std::abs(_tmin), std::abs(tmax) });
+    _tol = (Transform::fast_error*tabs
+         + 1e-12*(std::abs(_tmin)+std::abs(tmax)))*_scale + 1e-9;
+  }
+
+  index_type nbins () const noexcept { return _ndiv+2; }
+  index_type ndiv  () const noexcept { return _ndiv  ; }
+  index_type nedges() const noexcept { return _ndiv+1; }
+
+  edge_type edge(index_type i) const noexcept {
+    if (i == 0) return _min;
+    if (i >= _ndiv) return _max;
+    return edge_type(Transform::inverse(_tmin + i*_step));
+  }
+  edge_type operator[](index_type i) const noexcept { return edge(i); }
+
+  edge_type min() const noexcept { return _min; }
+  edge_type max() const noexcept { return _max; }
+
+  edge_type lower(index_type i) const noexcept {
+    if (i==0) return lowest;
+    if (i > _ndiv+1) return highest;
+    return edge(i-1);
+  }
+  edge_type upper(index_type i) const noexcept {
+    if (i > _ndiv) return highest;
+    return edge(i);
+  }
+
+  index_type find_bin_index(edge_type x) const noexcept {
+    if (x < _min) return 0;
+    return detail::correct_bin_index(
+      *this, x, (Transform::forward(x) - _tmin)*_scale, _tol);
+  }
+  index_type operator()(edge_type x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  void find_bin_indices(
+    std::span<const edge_type> xs, std::span<index_type> out
+  ) const noexcept {
+    const size_t n = std::min(xs.size(),out.size());
+    constexpr size_t chunk = 256;
+    double t[chunk];
+    const double tmin = _tmin, scale = _scale;
+    for (size_t k=0; k<n; k+=chunk) {
+      const size_t m = std::min(chunk,n-k);
+      const edge_type* x = xs.data()+k;
+      for (size_t i=0; i<m; ++i) // vectorized
+        t[i] = (Transform::fast(x[i]) - tmin)*scale;
+      for (size_t i=0; i<m; ++i)
+        out[k+i] = detail::correct_bin_index(*this,x[i],t[i],_tol);
+    }
+  }
+};
+
+// Integer axis =====================================================
+// One bin per integer in [min,max), plus underflow and overflow bins.
+template <typename Int = int>
+class integer_axis {
+  static_assert(std::is_integral_v<Int>);
+public:
+  using edge_type = Int;
+
+  static constexpr edge_type lowest = std::numeric_limits<edge_type>::lowest();
+  static constexpr edge_type highest = std::numeric_limits<edge_type>::max();
+
+private:
+  edge_type _min, _max;
+
+public:
+  constexpr integer_axis() noexcept = default;
+  constexpr integer_axis(const integer_axis&) noexcept = default;
+  constexpr integer_axis(integer_axis&&) noexcept = default;
+  constexpr integer_axis& operator=(const integer_axis&) noexcept = default;
+  constexpr integer_axis& operator=(integer_axis&&) noexcept = default;
+  ~integer_axis() = default;
+
+  constexpr integer_axis(edge_type min, edge_type max)
+  : _min(min), _max(max)
+  {
+    if (_max < _min) std::swap(_min,_max);
+    // the difference of signed edges may not fit edge_type
+    if (std::cmp_greater(udiff(),std::numeric_limits<index_type>::max()-2))
+      throw std::length_error(
+        "integer_axis number of bins overflows index_type");
+  }
+
+private:
+  constexpr auto udiff() const noexcept {
+    using U = std::make_unsigned_t<edge_type>;
+    return U(U(_max) - U(_min));
+  }
+
+public:
+  constexpr index_type nbins () const noexcept { return ndiv()+2; }
+  constexpr index_type ndiv  () const noexcept { return udiff(); }
+  constexpr index_type nedges() const noexcept { return ndiv()+1; }
+
+  constexpr edge_type edge(index_type i) const noexcept {
+    return _min + edge_type(i);
+  }
+  constexpr edge_type operator[](index_type i) const noexcept
+  { return edge(i); }
+
+  constexpr edge_type min() const noexcept { return _min; }
+  constexpr edge_type max() const noexcept { return _max; }
+
+  constexpr edge_type lower(index_type i) const noexcept {
+    if (i==0) return lowest;
+    if (i > ndiv()+1) return highest;
+    return edge(i-1);
+  }
+  constexpr edge_type upper(index_type i) const noexcept {
+    if (i > ndiv()) return highest;
+    return edge(i);
+  }
+
+  template <typename T>
+  constexpr index_type find_bin_index(T x) const noexcept {
+    if constexpr (std::is_integral_v<T>) {
+      if (std::cmp_less(x,_min)) return 0;
+      if (!std::cmp_less(x,_max)) return ndiv()+1;
+      using U = std::make_unsigned_t<edge_type>;
+      return index_type(U(U(edge_type(x)) - U(_min))) + 1;
+    } else {
+      if (x < _min) return 0;
+      if (!(x < _max)) return ndiv()+1;
+      return index_type(x - _min) + 1;
+    }
   }
-  constexpr index_type operator()(edge_type x) const noexcept {
+  template <typename T>
+  constexpr index_type operator()(T x) const noexcept {
     return find_bin_index(x);
   }
+
+  void find_bin_indices(
+    std::span<const edge_type> xs, std::span<index_type> out
+  ) const noexcept {
+    // offsets below min wrap around to large unsigned values
+    using U = std::make_unsigned_t<edge_type>;
+    const size_t n = std::min(xs.size(),out.size());
+    const edge_type min = _min;
+    const U ndiv = U(_max) - U(min);
+    for (size_t i=0; i<n; ++i) {
+      const edge_type x = xs[i];
+      const U d = U(x) - U(min);
+      out[i] = d < ndiv ? index_type(d)+1 : x < min ? 0 : index_type(ndiv)+1;
+    }
+  }
+};
+
+// Category axis ====================================================
+// Bin 0 collects values that match none of the labels,
+// bin i+1 corresponds to label i.
+// Labels are looked up in a flat open addressing hash table
+// with linear probing, kept at most half full.
+// A Growable axis adds a label when grow() is called with a new value.
+// Its bins are reserved in advance, doubling in number when they run out,
+// so bins past the last label are unused.
+template <typename Label = int, bool Growable = false>
+class category_axis {
+public:
+  using edge_type = Label;
+  using label_type = Label;
+  using key_type = std::conditional_t<
+    std::is_same_v<label_type,std::string>, std::string_view, label_type >;
+  static constexpr bool growable = Growable;
+
+private:
+  std::vector<label_type> _labels;
+  std::vector<index_type> _slots; // label index + 1, or 0 if empty
+  unsigned _shift;
+  index_type _ncat; // number of category bins, not less than labels
+
+  static std::uint64_t hash(const key_type& x) noexcept {
+    // Fibonacci hashing, so that identity hashes of integers spread out
+    return std::uint64_t(std::hash<key_type>{}(x)) * 0x9E37'79B9'7F4A'7C15ull;
+  }
+
+  void insert(index_type i) {
+    const key_type x = _labels[i];
+    const size_t mask = _slots.size()-1;
+    size_t s = hash(x) >> _shift;
+    for (; _slots[s]; s = (s+1) & mask)
+      if (key_type(_labels[_slots[s]-1]) == x)
+        throw std::invalid_argument("duplicate category axis label");
+    _slots[s] = i+1;
+  }
+
+  void build() {
+    const size_t cap = std::bit_ceil(std::max<size_t>(_labels.size()*2,2));
+    _shift = 64 - std::countr_zero(cap);
+    _slots.assign(cap,0);
+    for (index_type i=0, n=_labels.size(); i<n; ++i)
+      insert(i);
+  }
+
+public:
+  category_axis(): _ncat(0) { build(); }
+  category_axis(const category_axis&) = default;
+  category_axis(category_axis&&) noexcept = default;
+  category_axis& operator=(const category_axis&) = default;
+  category_axis& operator=(category_axis&&) noexcept = default;
+  ~category_axis() = default;
+
+  category_axis(std::vector<label_type> labels)
+  : _labels(std::move(labels)), _ncat(_labels.size()) { build(); }
+  category_axis(std::initializer_list<label_type> labels)
+  : _labels(labels), _ncat(_labels.size()) { build(); }
+  // with ncat category bins, e.g. reserved by a growable axis
+  category_axis(std::vector<label_type> labels, index_type ncat)
+  : _labels(std::move(labels)),
+    _ncat(std::max<index_type>(ncat,_labels.size())) { build(); }
+
+  index_type nbins () const noexcept { return _ncat+1; }
+  index_type ndiv  () const noexcept { return _ncat; }
+  index_type nedges() const noexcept { return _ncat; }
+  index_type nlabels() const noexcept { return _labels.size(); }
+
+  const label_type& label(index_type i) const noexcept { return _labels[i]; }
+  const label_type& edge(index_type i) const noexcept { return _labels[i]; }
+  const label_type& operator[](index_type i) const noexcept
+  { return _labels[i]; }
+
+  const std::vector<label_type>& labels() const noexcept { return _labels; }
+
+  index_type find_bin_index(const key_type& x) const noexcept {
+    const size_t mask = _slots.size()-1;
+    for (size_t s = hash(x) >> _shift; ; s = (s+1) & mask) {
+      const index_type i = _slots[s];
+      if (i==0 || key_type(_labels[i-1]) == x) return i;
+    }
+  }
+  // allows integer labels in a variant_axis with a floating edge_type
+  template <std::floating_point T>
+  requires std::is_integral_v<label_type>
+  index_type find_bin_index(T x) const noexcept {
+    using lim = std::numeric_limits<label_type>;
+    if (!( x >= T(lim::min()) && x < T(lim::max()/2+1)*2 )) return 0;
+    const label_type l(x);
+    return l == x ? find_bin_index(l) : 0;
+  }
+  template <typename T>
+  index_type operator()(const T& x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  void find_bin_indices(
+    std::span<const label_type> xs, std::span<index_type> out
+  ) const noexcept {
+    for (size_t i=0, n=std::min(xs.size(),out.size()); i<n; ++i)
+      out[i] = find_bin_index(xs[i]);
+  }
+
+  axis_growth grow(const key_type& x) requires Growable {
+    if (find_bin_index(x)) return { };
+    _labels.emplace_back(x);
+    if (_labels.size()*2 > _slots.size()) build();
+    else insert(_labels.size()-1);
+    if (_labels.size() <= _ncat) return { };
+    const index_type n = _ncat ? _ncat : 1;
+    _ncat += n;
+    return { 0, n, false };
+  }
+};
+
+// ==================================================================
+
+// Bin indices for a batch of coordinates.
+// Uses the axis's own batch kernel, if it has one for this coordinate type.
+template <typename Axis, typename T>
+void find_bin_indices(
+  const Axis& a, std::span<const T> xs, std::span<index_type> out
+) {
+  if constexpr (requires { a.find_bin_indices(xs,out); })
+    a.find_bin_indices(xs,out);
+  else
+    for (size_t i=0, n=std::min(xs.size(),out.size()); i<n; ++i)
+      out[i] = a.find_bin_index(xs[i]);
+}
+
+// Axis without flow bins =========================================
+// Drops the underflow and overflow bins of an axis.
+// Out of range coordinates get an index not less than nbins().
+// A histogram counts fills at such coordinates in one extra bin
+// at the end of its storage.
+template <typename Axis>
+class noflow_axis {
+public:
+  using axis_type = Axis;
+  using edge_type = typename axis_type::edge_type;
+  static constexpr bool flow = false;
+
+private:
+  axis_type _axis;
+
+public:
+  noflow_axis() = default;
+  noflow_axis(const noflow_axis&) = default;
+  noflow_axis(noflow_axis&&) = default;
+  noflow_axis& operator=(const noflow_axis&) = default;
+  noflow_axis& operator=(noflow_axis&&) = default;
+  ~noflow_axis() = default;
+
+  template <typename... Args>
+  requires std::is_constructible_v<axis_type,Args&&...>
+  noflow_axis(Args&&... args)
+  noexcept(std::is_nothrow_constructible_v<axis_type,Args&&...>)
+  : _axis(std::forward<Args>(args)...) { }
+
+  const axis_type& axis() const noexcept { return _axis; }
+
+  index_type nbins () const noexcept { return _axis.ndiv(); }
+  index_type ndiv  () const noexcept { return _axis.ndiv(); }
+  index_type nedges() const noexcept { return _axis.nedges(); }
+
+  decltype(auto) edge(index_type i) const noexcept { return _axis.edge(i); }
+  decltype(auto) operator[](index_type i) const noexcept { return edge(i); }
+
+  decltype(auto) min() const noexcept { return _axis.min(); }
+  decltype(auto) max() const noexcept { return _axis.max(); }
+
+  decltype(auto) lower(index_type i) const noexcept { return edge(i); }
+  decltype(auto) upper(index_type i) const noexcept { return edge(i+1); }
+
+  // underflow wraps around to the largest index
+  template <typename T>
+  index_type find_bin_index(const T& x) const noexcept {
+    return _axis.find_bin_index(x) - 1;
+  }
+  template <typename T>
+  index_type operator()(const T& x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  template <typename T>
+  void find_bin_indices(
+    std::span<const T> xs, std::span<index_type> out
+  ) const {
+    const size_t n = std::min(xs.size(),out.size());
+    hist::find_bin_indices(_axis, xs, out.first(n));
+    for (size_t i=0; i<n; ++i) --out[i];
+  }
+};
+
+template <typename Axis>
+concept NoflowAxis = requires {
+  requires !std::remove_cvref_t<Axis>::flow;
+};
+
+// Hinted axis ======================================================
+// Starts each lookup from the bin index found by the previous one,
+// for coordinates that arrive sorted or nearly sorted.
+// Batch lookups merge sorted coordinates with the edges in linear time.
+// Axes without a hinted lookup are searched as usual.
+// The hint is mutable, so lookups on a shared axis are not thread safe.
+template <typename Axis>
+class hinted_axis {
+public:
+  using axis_type = Axis;
+  using edge_type = typename axis_type::edge_type;
+  static constexpr bool flow = !NoflowAxis<axis_type>;
+
+private:
+  axis_type _axis;
+  mutable index_type _hint = 0;
+
+public:
+  hinted_axis() = default;
+  hinted_axis(const hinted_axis&) = default;
+  hinted_axis(hinted_axis&&) = default;
+  hinted_axis& operator=(const hinted_axis&) = default;
+  hinted_axis& operator=(hinted_axis&&) = default;
+  ~hinted_axis() = default;
+
+  template <typename... Args>
+  requires std::is_constructible_v<axis_type,Args&&...>
+  hinted_axis(Args&&... args)
+  noexcept(std::is_nothrow_constructible_v<axis_type,Args&&...>)
+  : _axis(std::forward<Args>(args)...) { }
+
+  const axis_type& axis() const noexcept { return _axis; }
+  index_type hint() const noexcept { return _hint; }
+  void hint(index_type i) const noexcept { _hint = i; }
+
+  index_type nbins () const noexcept { return _axis.nbins (); }
+  index_type ndiv  () const noexcept { return _axis.ndiv  (); }
+  index_type nedges() const noexcept { return _axis.nedges(); }
+
+  decltype(auto) edge(index_type i) const noexcept { return _axis.edge(i); }
+  decltype(auto) operator[](index_type i) const noexcept { return edge(i); }
+
+  decltype(auto) min() const noexcept { return _axis.min(); }
+  decltype(auto) max() const noexcept { return _axis.max(); }
+
+  decltype(auto) lower(index_type i) const noexcept { return _axis.lower(i); }
+  decltype(auto) upper(index_type i) const noexcept { return _axis.upper(i); }
+
+  template <typename T>
+  index_type find_bin_index(const T& x) const noexcept {
+    if constexpr (requires { _axis.find_bin_index(x,_hint); })
+      return _hint = _axis.find_bin_index(x,_hint);
+    else
+      return _axis.find_bin_index(x);
+  }
+  template <typename T>
+  index_type operator()(const T& x) const noexcept {
+    return find_bin_index(x);
+  }
+
+  template <typename T>
+  void find_bin_indices(
+    std::span<const T> xs, std::span<index_type> out
+  ) const {
+    const size_t n = std::min(xs.size(),out.size());
+    if (n == 0) return;
+    if constexpr (requires {
+      _axis.find_sorted_bin_indices(xs,out,_hint);
+    }) {
+      _axis.find_sorted_bin_indices(xs,out.first(n),_hint);
+      _hint = out[n-1];
+    } else {
+      hist::find_bin_indices(_axis, xs, out.first(n));
+    }
+  }
 };
 
 // Variant axis =====================================================
@@ -244,32 +1267,39 @@ public:
     return std::visit([](auto& ax){ return ax.nedges(); }, ax);
   }
 
-  decltype(auto) edge(index_type i) const {
-    return std::visit([i](auto& ax){ return ax.edge(i); }, ax);
+  edge_type edge(index_type i) const {
+    return std::visit([i](auto& ax){ return edge_type(ax.edge(i)); }, ax);
   }
-  decltype(auto) operator[](index_type i) const { return edge(i); }
+  edge_type operator[](index_type i) const { return edge(i); }
 
-  decltype(auto) min() const {
-    return std::visit([](auto& ax){ return ax.min(); }, ax);
+  edge_type min() const {
+    return std::visit([](auto& ax){ return edge_type(ax.min()); }, ax);
   }
-  decltype(auto) max() const {
-    return std::visit([](auto& ax){ return ax.max(); }, ax);
+  edge_type max() const {
+    return std::visit([](auto& ax){ return edge_type(ax.max()); }, ax);
   }
 
-  decltype(auto) lower(index_type i) const {
-    return std::visit([i](auto& ax){ return ax.lower(i); }, ax);
+  edge_type lower(index_type i) const {
+    return std::visit([i](auto& ax){ return edge_type(ax.lower(i)); }, ax);
   }
-  decltype(auto) upper(index_type i) const {
-    return std::visit([i](auto& ax){ return ax.upper(i); }, ax);
+  edge_type upper(index_type i) const {
+    return std::visit([i](auto& ax){ return edge_type(ax.upper(i)); }, ax);
   }
 
   index_type find_bin_index(const auto& x) const {
-    return std::visit([x](auto& ax){ return ax.find_bin_index(x); }, ax);
+    return std::visit([&x](auto& ax){ return ax.find_bin_index(x); }, ax);
   }
   index_type operator()(const auto& x) const {
     return find_bin_index(x);
   }
 
+  // visits once for the whole batch
+  void find_bin_indices(
+    std::span<const edge_type> xs, std::span<index_type> out
+  ) const {
+    std::visit([=](auto& ax){ hist::find_bin_indices(ax,xs,out); }, ax);
+  }
+
   const auto& operator*() const { return ax; }
   auto& operator*() { return ax; }
 };
@@ -0,0 +1,114 @@
+#ifndef IVANP_HISTOGRAMS_AXIS_REGISTRY_HH
+#define IVANP_HISTOGRAMS_AXIS_REGISTRY_HH
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include <type_traits>
+
+#include <ivanp/hist/axes.hh>
+
+namespace ivanp::hist {
+
+// Shared handle to an immutable axis ==============================
+// Works as an element of axes_spec through get_axis_ref().
+// Handles to interned axes with equal content point to the same axis.
+template <typename Axis>
+class axis_ref {
+public:
+  using axis_type = Axis;
+  using edge_type = typename axis_type::edge_type;
+
+private:
+  std::shared_ptr<const axis_type> _p;
+
+public:
+  axis_ref() noexcept = default;
+  explicit axis_ref(std::shared_ptr<const axis_type> p) noexcept
+  : _p(std::move(p)) { }
+
+  const axis_type& operator*() const noexcept { return *_p; }
+  const axis_type* operator->() const noexcept { return _p.get(); }
+  const axis_type* get() const noexcept { return _p.get(); }
+  explicit operator bool() const noexcept { return bool(_p); }
+
+  friend bool operator==(const axis_ref& a, const axis_ref& b) noexcept {
+    return a._p == b._p;
+  }
+};
+
+namespace detail {
+
+template <typename Axis>
+size_t axis_hash(const Axis& a) noexcept {
+  using edge_type = std::remove_cvref_t<decltype(a.edge(0))>;
+  size_t h = a.nbins();
+  for (index_type i=0, n=a.nedges(); i<n; ++i) // FNV-1a over edge hashes
+    h = (h ^ std::hash<edge_type>{}(a.edge(i))) * 0x100'0000'01B3ull;
+  return h;
+}
+
+template <typename Axis>
+bool same_axis(const Axis& a, const Axis& b) noexcept {
+  if (a.nbins() != b.nbins() || a.nedges() != b.nedges()) return false;
+  for (index_type i=0, n=a.nedges(); i<n; ++i)
+    if (!(a.edge(i) == b.edge(i))) return false;
+  return true;
+}
+
+} // end namespace detail
+
+// Axis registry ====================================================
+// Interns axes by content, so that equal axes share storage.
+// Lookup hashes the edges once per intern() call.
+template <typename Axis>
+class axis_registry {
+public:
+  using axis_type = Axis;
+  using ref_type = axis_ref<axis_type>;
+
+private:
+  std::unordered_multimap<size_t,std::shared_ptr<const axis_type>> _axes;
+  mutable std::mutex _mx;
+
+public:
+  template <typename A>
+  requires std::is_constructible_v<axis_type,A&&>
+  ref_type intern(A&& a) {
+    axis_type axis(std::forward<A>(a));
+    const size_t h = detail::axis_hash(axis);
+    const std::lock_guard lock(_mx);
+    for (auto [it, end] = _axes.equal_range(h); it != end; ++it)
+      if (detail::same_axis(*it->second,axis))
+        return ref_type(it->second);
+    return ref_type(_axes.emplace(
+      h, std::make_shared<const axis_type>(std::move(axis)) )->second);
+  }
+
+  size_t size() const {
+    const std::lock_guard lock(_mx);
+    return _axes.size();
+  }
+
+  // Forget axes not referenced outside of the registry
+  void prune() {
+    const std::lock_guard lock(_mx);
+    std::erase_if(_axes, [](const auto& x){ return x.second.use_count()==1; });
+  }
+
+  static axis_registry& global() {
+    static axis_registry registry;
+    return registry;
+  }
+};
+
+template <typename A>
+axis_ref<std::remove_cvref_t<A>> intern_axis(A&& a) {
+  return axis_registry<std::remove_cvref_t<A>>::global()
+    .intern(std::forward<A>(a));
+}
+
+} // end namespace ivanp::hist
+
+#endif
@@ -43,7 +43,7 @@ struct bin_filler {
   { return bin += std::forward<T>(x); }
 
   template <typename Bin, typename T1, typename... TT>
-  requires ( sizeof...(TT) || !can_increment_by<Bin,T1&&>)
+  requires ( sizeof...(TT) > 0 || !can_increment_by<Bin,T1&&>)
         && can_invoke<Bin&,T1&&,TT&&...>
   static decltype(auto) fill(Bin& bin, T1&& x1, TT&&... xs)
   noexcept(std::is_nothrow_invocable_v<Bin&,T1&&,TT&&...>)
@@ -0,0 +1,787 @@
+#ifndef IVANP_HISTOGRAMS_BINARY_HH
+#define IVANP_HISTOGRAMS_BINARY_HH
+
+#ifndef IVANP_HISTOGRAMS_HH
+#error "must include histograms.hh first"
+#else
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <span>
+#include <ostream>
+#include <fstream>
+#include <system_error>
+
+#include <ivanp/hist/json.hh>
+#include <ivanp/hist/mapped_file.hh>
+#include <ivanp/hist/parallel.hh>
+
+// Binary container for histogram dictionaries, see README.md.
+// Bins are stored as raw arrays of the iterated bin type,
+// so a mapped file can be read without parsing or copying the bins.
+// Axis and bin definitions are stored in the JSON format of json.hh.
+
+namespace ivanp::hist {
+
+// Histogram with read-only bins in memory it does not own
+template <typename Bin = double, typename Axes = std::vector<cont_axis<>>>
+using histogram_view = histogram<
+  Bin, axes_spec<Axes>, bins_spec<std::span<const Bin>> >;
+
+namespace detail {
+
+struct binary_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t nhists;
+  uint64_t index;
+  uint64_t axes, axes_size;
+  uint64_t bins, bins_size;
+};
+static_assert(sizeof(binary_header) == 64);
+
+struct binary_entry {
+  uint64_t name;
+  uint32_t name_size;
+  uint32_t naxes;
+  uint64_t axes;
+  uint32_t bin_def;
+  uint32_t bin_size;
+  uint64_t bins;
+  uint64_t nbins;
+};
+static_assert(sizeof(binary_entry) == 48);
+
+constexpr char binary_magic[8] = { 'I','V','P','H','I','S','T','\0' };
+constexpr char binary_delta_magic[8] = { 'I','V','P','D','E','L','T','\0' };
+constexpr char binary_compressed_magic[8] = { 'I','V','P','H','C','M','P','\0' };
+constexpr uint32_t binary_version = 1;
+constexpr uint32_t binary_byte_order = 0x01020304;
+constexpr uint64_t binary_align = 64;
+constexpr uint64_t binary_block_bytes = 1 << 16; // of compressed blocks
+
+constexpr uint64_t binary_pad(uint64_t n) noexcept {
+  return (n + binary_align-1) & ~(binary_align-1);
+}
+
+[[noreturn]] inline void bad_binary(const std::string& what) {
+  throw std::invalid_argument("histogram binary: "+what);
+}
+
+// type of the bins as they are iterated and written
+template <Histogram H>
+using stored_bin_t = std::decay_t<decltype(*std::declval<const H&>().begin())>;
+
+// bins expected from the axes of h
+template <Histogram H>
+uint64_t expected_nbins(const H& h) {
+  index_type n = 1;
+  cont::map([&n](const auto& a) {
+    n = checked_mul(n,get_axis_ref(a).nbins());
+  }, h.axes());
+  return uint64_t(n) + H::noflow;
+}
+
+// Compression ======================================================
+// Blocks of bins are byte shuffled, so that byte k of every bin is
+// followed by byte k of the next bin, and each byte is replaced by its
+// difference from the previous one. Smooth weights and empty bins then
+// give long runs of equal bytes, which are compressed with LZ77.
+// Sequences have the format of LZ4 blocks: a token byte with the number
+// of literals and match bytes, more bytes of these numbers if they are
+// at least 15, the literals, and a 16 bit little endian match offset.
+// The last sequence has only literals.
+
+enum : uint8_t { block_stored = 0, block_lz = 1 };
+
+inline void lz_compress(const uint8_t* src, size_t n, std::string& out) {
+  constexpr unsigned hash_bits = 14;
+  std::vector<uint32_t> table(size_t(1) << hash_bits);
+  const auto read32 = [src](size_t i) {
+    uint32_t x;
+    std::memcpy(&x,src+i,sizeof(x));
+    return x;
+  };
+  const auto put_len = [&](size_t len) {
+    for (; len >= 255; len -= 255) out.push_back(char(255));
+    out.push_back(char(len));
+  };
+  const auto put_literals = [&](size_t a, size_t b, unsigned m) {
+    const size_t lit = b - a;
+    out.push_back(char((std::min<size_t>(lit,15) << 4) | m));
+    if (lit >= 15) put_len(lit - 15);
+    out.append(reinterpret_cast<const char*>(src+a),lit);
+  };
+  size_t anchor = 0, miss = 0;
+  for (size_t i = 0; i + 4 <= n; ) {
+    const uint32_t seq = read32(i);
+    uint32_t& slot = table[(seq * 2654435761u) >> (32 - hash_bits)];
+    const size_t ref = slot;
+    slot = i;
+    if (ref < i && i - ref <= 0xFFFF && read32(ref) == seq) {
+      size_t len = 4;
+      while (i + len < n && src[ref+len] == src[i+len]) ++len;
+      const size_t m = len - 4;
+      put_literals(anchor,i,std::min<size_t>(m,15));
+      out.push_back(char((i - ref) & 0xFF));
+      out.push_back(char((i - ref) >> 8));
+      if (m >= 15) put_len(m - 15);
+      anchor = i += len;
+      miss = 0;
+    } else i += 1 + (miss++ >> 5); // faster through incompressible data
+  }
+  put_literals(anchor,n,0);
+}
+
+// false if the data is corrupt or does not decompress to m bytes
+inline bool lz_decompress(
+  const uint8_t* p, size_t n, uint8_t* dst, size_t m
+) noexcept {
+  const uint8_t* const end = p + n;
+  const auto get_len = [&](size_t& len) {
+    for (;;) {
+      if (p == end) return false;
+      const uint8_t b = *p++;
+      len += b;
+      if (b != 255) return true;
+    }
+  };
+  size_t o = 0;
+  for (;;) {
+    if (p == end) return false; // no last sequence
+    const unsigned token = *p++;
+    size_t lit = token >> 4;
+    if (lit == 15 && !get_len(lit)) return false;
+    if (lit > size_t(end - p) || lit > m - o) return false;
+    std::memcpy(dst+o,p,lit);
+    p += lit;
+    o += lit;
+    if (p == end) return o == m; // the last sequence
+    if (end - p < 2) return false;
+    const size_t off = p[0] | (size_t(p[1]) << 8);
+    p += 2;
+    size_t len = token & 15;
+    if (len == 15 && !get_len(len)) return false;
+    len += 4;
+    if (off == 0 || off > o || len > m - o) return false;
+    for (const size_t e = o + len; o < e; ++o) // may overlap
+      dst[o] = dst[o-off];
+  }
+}
+
+// appends the compressed block of n bins of the given size
+inline void compress_block(
+  const char* bins, size_t n, size_t size, std::string& out
+) {
+  std::vector<uint8_t> planes(n*size);
+  for (size_t k=0; k<size; ++k) {
+    uint8_t* const plane = planes.data() + k*n;
+    uint8_t prev = 0;
+    for (size_t i=0; i<n; ++i) {
+      const uint8_t b = bins[i*size + k];
+      plane[i] = b - prev;
+      prev = b;
+    }
+  }
+  const size_t start = out.size();
+  out.push_back(char(block_lz));
+  lz_compress(planes.data(),planes.size(),out);
+  if (out.size() - start > planes.size()) { // incompressible
+    out.resize(start);
+    out.push_back(char(block_stored));
+    out.append(bins,n*size);
+  }
+}
+
+inline void decompress_block(
+  const char* p, size_t len, char* bins, size_t n, size_t size
+) {
+  if (len == 0) bad_binary("empty block");
+  const auto method = uint8_t(*p);
+  ++p;
+  --len;
+  if (method == block_stored) {
+    if (len != n*size) bad_binary("bad block size");
+    std::memcpy(bins,p,len);
+    return;
+  }
+  if (method != block_lz) bad_binary("unknown block compression");
+  std::vector<uint8_t> planes(n*size);
+  if (!lz_decompress(reinterpret_cast<const uint8_t*>(p), len,
+    planes.data(), planes.size())) bad_binary("corrupt block");
+  for (size_t k=0; k<size; ++k) {
+    const uint8_t* const plane = planes.data() + k*n;
+    uint8_t b = 0;
+    for (size_t i=0; i<n; ++i)
+      bins[i*size + k] = b += plane[i];
+  }
+}
+
+// Block table, followed by the blocks:
+// bins in a block, number of blocks, and offsets of the blocks
+// and of their end relative to the table.
+template <Histogram H>
+std::string compress_bins(const H& h) {
+  using bin_t = stored_bin_t<H>;
+  const uint64_t nbins = h.nbins();
+  const uint64_t block = std::max<uint64_t>(
+    binary_block_bytes / sizeof(bin_t), 1 );
+  const uint64_t nblocks = (nbins + block-1) / block;
+  std::vector<uint64_t> table(3 + nblocks);
+  table[0] = block;
+  table[1] = nblocks;
+  std::string out(table.size()*sizeof(uint64_t),'\0');
+  std::vector<char> buf(block*sizeof(bin_t));
+  uint64_t j = 0, k = 0;
+  const auto flush = [&]{
+    table[2 + j++] = out.size();
+    compress_block(buf.data(),k,sizeof(bin_t),out);
+    k = 0;
+  };
+  for (const bin_t& b : h) {
+    std::memcpy(buf.data() + k*sizeof(bin_t), &b, sizeof(bin_t));
+    if (++k == block) flush();
+  }
+  if (k) flush();
+  table[2 + j] = out.size();
+  std::memcpy(out.data(), table.data(), table.size()*sizeof(uint64_t));
+  return out;
+}
+
+} // end namespace detail
+
+// Writing ==========================================================
+
+namespace detail {
+
+// histograms that track which pages of their bins changed
+template <typename H>
+concept TrackedHistogram = requires (H& h, size_t k) {
+  { h.bins().dirty(k) } -> std::convertible_to<bool>;
+  h.bins().page(k);
+  h.bins().clean();
+  H::bins_type::page_size;
+};
+
+// Full histograms, or only the dirty pages of tracked histograms.
+// Compressed bins are encoded by the given number of threads.
+template <bool Delta, bool Compress = false>
+void write_binary(
+  std::ostream& out, const HistogramDict auto& hs, unsigned threads = 1
+) {
+  using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
+  using bin_t = stored_bin_t<hist_t>;
+  static_assert(!hist_t::perbin_axes,
+    "binary format does not support perbin_axes");
+  static_assert(std::is_trivially_copyable_v<bin_t>,
+    "binary format requires trivially copyable bins");
+  static_assert(alignof(bin_t) <= binary_align);
+  static_assert(!Delta || TrackedHistogram<hist_t>,
+    "delta checkpoints require tracked bins");
+  static_assert(!(Delta && Compress),
+    "delta checkpoints are not compressed");
+
+  struct hist_info {
+    std::string_view name;
+    const hist_t* h;
+    std::vector<uint32_t> axes;
+    uint32_t bin_def;
+    std::vector<uint64_t> pages; // dirty pages
+  };
+  std::vector<hist_info> info;
+  nlohmann::json axes = nlohmann::json::array(),
+                 bins = nlohmann::json::array();
+  json_index axis_ids, bin_ids;
+  for (const auto& [name, h_ptr] : hs) {
+    std::vector<uint64_t> pages;
+    if constexpr (Delta) {
+      const auto& b = h_ptr->bins();
+      for (size_t k=0, n=b.npages(); k<n; ++k)
+        if (b.dirty(k)) pages.push_back(k);
+      if (pages.empty()) continue;
+    }
+    auto& x = info.emplace_back();
+    x.name = name;
+    x.h = &*h_ptr;
+    cont::map([&](const auto& a) {
+      x.axes.push_back(axis_ids(axes,nlohmann::json(a)));
+    }, h_ptr->axes());
+    x.bin_def = bin_ids(bins,bin_def<bin_t>::def());
+    x.pages = std::move(pages);
+  }
+  // sorted by name for binary search
+  std::sort(info.begin(),info.end(),
+    [](const auto& a, const auto& b){ return a.name < b.name; });
+  const std::string axes_str = axes.dump(), bins_str = bins.dump();
+
+  std::vector<std::string> packed; // compressed bins
+  if constexpr (Compress) {
+    packed.resize(info.size());
+    parallel_for(info.size(),threads,[&](size_t i){
+      packed[i] = compress_bins(*info[i].h);
+    });
+  }
+
+  binary_header head { };
+  std::memcpy(head.magic,
+    Delta ? binary_delta_magic :
+    Compress ? binary_compressed_magic : binary_magic,
+    sizeof(head.magic));
+  head.version = binary_version;
+  head.byte_order = binary_byte_order;
+  head.nhists = info.size();
+  head.index = sizeof(head);
+  uint64_t pos = head.index + info.size()*sizeof(binary_entry);
+
+  std::vector<binary_entry> index(info.size());
+  for (size_t i=0; i<info.size(); ++i) {
+    index[i].axes = pos;
+    pos += (index[i].naxes = info[i].axes.size()) * sizeof(uint32_t);
+  }
+  for (size_t i=0; i<info.size(); ++i) {
+    index[i].name = pos;
+    pos += (index[i].name_size = info[i].name.size());
+  }
+  head.axes = pos;
+  pos += (head.axes_size = axes_str.size());
+  head.bins = pos;
+  pos += (head.bins_size = bins_str.size());
+  for (size_t i=0; i<info.size(); ++i) {
+    auto& e = index[i];
+    e.bin_def = info[i].bin_def;
+    e.bin_size = sizeof(bin_t);
+    e.bins = pos = binary_pad(pos);
+    e.nbins = info[i].h->nbins();
+    if constexpr (Delta) {
+      constexpr uint64_t page_size = hist_t::bins_type::page_size;
+      pos = binary_pad(pos + (2 + info[i].pages.size())*sizeof(uint64_t));
+      for (uint64_t k : info[i].pages)
+        pos += std::min(page_size, e.nbins - k*page_size) * sizeof(bin_t);
+    } else if constexpr (Compress) {
+      pos += packed[i].size();
+    } else {
+      pos += e.nbins * sizeof(bin_t);
+    }
+  }
+
+  uint64_t written = 0;
+  const auto put = [&](const void* p, size_t n) {
+    if (!out.write(static_cast<const char*>(p),n))
+      throw std::runtime_error("histogram binary: stream write failed");
+    written += n;
+  };
+  static constexpr char zeros[binary_align] { };
+  const auto pad = [&]{ put(zeros,binary_pad(written) - written); };
+  put(&head,sizeof(head));
+  put(index.data(),index.size()*sizeof(index[0]));
+  for (const auto& x : info) put(x.axes.data(),x.axes.size()*sizeof(uint32_t));
+  for (const auto& x : info) put(x.name.data(),x.name.size());
+  put(axes_str.data(),axes_str.size());
+  put(bins_str.data(),bins_str.size());
+  std::vector<char> buf;
+  for (size_t i=0; i<info.size(); ++i) {
+    const auto& x = info[i];
+    pad();
+    const auto& bins = x.h->bins();
+    if constexpr (Delta) {
+      const uint64_t table[2] { hist_t::bins_type::page_size, x.pages.size() };
+      put(table,sizeof(table));
+      put(x.pages.data(),x.pages.size()*sizeof(uint64_t));
+      pad();
+      for (uint64_t k : x.pages) {
+        const auto page = bins.page(k);
+        put(page.data(),page.size()*sizeof(bin_t));
+      }
+    } else if constexpr (Compress) {
+      put(packed[i].data(),packed[i].size());
+    } else if constexpr (
+      std::ranges::contiguous_range<decltype(bins)> &&
+      std::is_same_v<std::ranges::range_value_t<decltype(bins)>,bin_t>
+    ) {
+      put(std::ranges::data(bins),x.h->nbins()*sizeof(bin_t));
+    } else { // staged through a buffer
+      constexpr size_t nbuf = (size_t(1) << 16) / sizeof(bin_t) + 1;
+      buf.resize(nbuf*sizeof(bin_t));
+      size_t k = 0;
+      for (const bin_t& b : *x.h) {
+        std::memcpy(buf.data() + k*sizeof(bin_t), &b, sizeof(bin_t));
+        if (++k == nbuf) {
+          put(buf.data(),buf.size());
+          k = 0;
+        }
+      }
+      put(buf.data(),k*sizeof(bin_t));
+    }
+  }
+}
+
+template <typename F>
+void write_binary_file(const std::string& path, F&& write) {
+  std::ofstream out(path,std::ios::binary);
+  if (!out) throw std::system_error(errno,std::generic_category(),
+    "histogram binary: cannot open "+path);
+  write(out);
+  out.close();
+  if (!out) throw std::runtime_error(
+    "histogram binary: cannot write "+path);
+}
+
+} // end namespace detail
+
+template <HistogramDict Dict>
+void write_binary(std::ostream& out, const Dict& hs) {
+  detail::write_binary<false>(out,hs);
+}
+
+template <HistogramDict Dict>
+void write_binary(const std::string& path, const Dict& hs) {
+  detail::write_binary_file(path,[&](std::ostream& out){
+    write_binary(out,hs);
+  });
+}
+
+// Compressed bins ==================================================
+// Bins are compressed in independent blocks of about 64 KiB,
+// by the given number of threads, or by all cores if 0.
+// binary_file decompresses only the histograms that are read.
+
+template <HistogramDict Dict>
+void write_binary_compressed(
+  std::ostream& out, const Dict& hs, unsigned threads = 0
+) {
+  detail::write_binary<false,true>(out,hs,threads);
+}
+
+template <HistogramDict Dict>
+void write_binary_compressed(
+  const std::string& path, const Dict& hs, unsigned threads = 0
+) {
+  detail::write_binary_file(path,[&](std::ostream& out){
+    write_binary_compressed(out,hs,threads);
+  });
+}
+
+// Delta checkpoints ================================================
+// Histograms with tracked_bins can be saved incrementally.
+// A delta holds only the pages of bins that changed since the previous
+// checkpoint, and histograms without changes are left out.
+// The pages are marked clean after they are written.
+// New bins start dirty, so the first delta is a full checkpoint.
+// binary_file::get() replays checkpoints, and compact_binary() merges
+// a base and its deltas into a single file.
+
+template <HistogramDict Dict>
+void write_binary_delta(std::ostream& out, Dict& hs) {
+  detail::write_binary<true>(out,hs);
+  for (auto& [name, h_ptr] : hs)
+    h_ptr->bins().clean();
+}
+
+template <HistogramDict Dict>
+void write_binary_delta(const std::string& path, Dict& hs) {
+  detail::write_binary_file(path,[&](std::ostream& out){
+    write_binary_delta(out,hs);
+  });
+}
+
+// Reading ==========================================================
+
+// The file is mapped read-only. Histograms with std::span bins,
+// such as histogram_view, point into the mapping, and must not
+// outlive the binary_file. Other histograms get a copy of the bins.
+class binary_file {
+  detail::mapped_file _file;
+  const char* _data;
+  std::vector<detail::binary_entry> _index;
+  nlohmann::json _axes, _bins;
+  bool _delta, _compressed;
+  unsigned _threads = 1;
+
+  void check_range(uint64_t off, uint64_t n, const char* what) const {
+    if (off > _file.size() || n > _file.size() - off)
+      detail::bad_binary(std::string(what)+" past the end of the file");
+  }
+
+  // definitions of the axes of entry e
+  nlohmann::json axes_json(const detail::binary_entry& e) const {
+    nlohmann::json axes = nlohmann::json::array();
+    const char* p = _data + e.axes;
+    for (uint32_t k=0; k<e.naxes; ++k, p+=sizeof(uint32_t)) {
+      uint32_t id;
+      std::memcpy(&id,p,sizeof(id));
+      axes.push_back(_axes.at(id));
+    }
+    return axes;
+  }
+
+  template <Histogram H>
+  void check_bins(const detail::binary_entry& e) const {
+    using bin_t = detail::stored_bin_t<H>;
+    static_assert(!H::perbin_axes,
+      "binary format does not support perbin_axes");
+    if (_bins.at(e.bin_def) != bin_def<bin_t>::def())
+      detail::bad_binary("bin definition does not match the bin type");
+    if (e.bin_size != sizeof(bin_t))
+      detail::bad_binary("bin size does not match the bin type");
+  }
+
+  template <Histogram H>
+  void read(const detail::binary_entry& e, H& h) const {
+    using bin_t = detail::stored_bin_t<H>;
+    if (_delta) detail::bad_binary(
+      "a delta checkpoint can only be read into a dictionary");
+    check_bins<H>(e);
+    h = H(detail::axes_from_json<std::remove_cvref_t<typename H::axes_type>>(
+      axes_json(e), nullptr ));
+    if (e.nbins != detail::expected_nbins(h))
+      detail::bad_binary("number of bins does not match the axes");
+    const char* const bins = _data + e.bins;
+    if constexpr (std::is_same_v<
+      typename H::bins_type, std::span<const bin_t>
+    >) {
+      if (_compressed)
+        detail::bad_binary("compressed bins cannot be viewed in place");
+      if (reinterpret_cast<uintptr_t>(bins) % alignof(bin_t))
+        detail::bad_binary("misaligned bins");
+      h.bins() = { reinterpret_cast<const bin_t*>(bins), size_t(e.nbins) };
+    } else {
+      static_assert(std::is_same_v<bin_t,typename H::bin_type>,
+        "bins can only be read into a histogram that stores them as is");
+      if (_compressed) read_blocks(e,h);
+      else for (uint64_t i=0; i<e.nbins; ++i)
+        std::memcpy(&h.bin_at(i), bins + i*sizeof(bin_t), sizeof(bin_t));
+    }
+  }
+
+  // blocks are decompressed in parallel to a buffer,
+  // because writing bins can have side effects, e.g. in tracked_bins
+  template <Histogram H>
+  void read_blocks(const detail::binary_entry& e, H& h) const {
+    using bin_t = detail::stored_bin_t<H>;
+    const char* const table = _data + e.bins;
+    uint64_t block;
+    std::memcpy(&block, table, sizeof(block));
+    std::vector<char> bins(e.nbins*sizeof(bin_t));
+    detail::parallel_for((e.nbins + block-1) / block, _threads,
+      [&](size_t j){
+        uint64_t off[2];
+        std::memcpy(off, table + (2+j)*sizeof(uint64_t), sizeof(off));
+        const uint64_t first = j*block;
+        detail::decompress_block(table + off[0], off[1] - off[0],
+          bins.data() + first*sizeof(bin_t),
+          std::min(block, e.nbins - first), sizeof(bin_t));
+      });
+    for (uint64_t i=0; i<e.nbins; ++i)
+      std::memcpy(&h.bin_at(i), bins.data() + i*sizeof(bin_t), sizeof(bin_t));
+  }
+
+  // overwrites the pages of a delta,
+  // h is reset if its axes differ from those in the delta
+  template <Histogram H>
+  void read_delta(const detail::binary_entry& e, H& h) const {
+    using bin_t = detail::stored_bin_t<H>;
+    if constexpr (
+      !std::is_same_v<bin_t,typename H::bin_type> ||
+      std::is_same_v<typename H::bins_type, std::span<const bin_t>>
+    ) {
+      detail::bad_binary("a delta checkpoint can only be applied to "
+        "histograms that store their bins as is");
+    } else {
+      check_bins<H>(e);
+      const auto axes = axes_json(e);
+      if (nlohmann::json(h.axes()) != axes)
+        h = H(detail::axes_from_json<std::remove_cvref_t<typename H::axes_type>>(
+          axes, nullptr ));
+      if (e.nbins != detail::expected_nbins(h))
+        detail::bad_binary("number of bins does not match the axes");
+      uint64_t table[2];
+      std::memcpy(table, _data + e.bins, sizeof(table));
+      const auto [page_size, npages] = table;
+      const char* p = _data + detail::binary_pad(
+        e.bins + (2 + npages)*sizeof(uint64_t) );
+      for (uint64_t j=0; j<npages; ++j) {
+        uint64_t k;
+        std::memcpy(&k, _data + e.bins + (2+j)*sizeof(uint64_t), sizeof(k));
+        const uint64_t first = k*page_size,
+                       last = std::min(first+page_size, e.nbins);
+        for (uint64_t i=first; i<last; ++i, p+=sizeof(bin_t))
+          std::memcpy(&h.bin_at(i), p, sizeof(bin_t));
+      }
+    }
+  }
+
+  void check_delta(const detail::binary_entry& e) const {
+    check_range(e.bins,2*sizeof(uint64_t),"page table");
+    uint64_t table[2];
+    std::memcpy(table, _data + e.bins, sizeof(table));
+    const auto [page_size, npages] = table;
+    if (page_size == 0 || npages > _file.size() / sizeof(uint64_t))
+      detail::bad_binary("bad page table");
+    check_range(e.bins,(2+npages)*sizeof(uint64_t),"page table");
+    uint64_t size = 0;
+    for (uint64_t j=0; j<npages; ++j) {
+      uint64_t k;
+      std::memcpy(&k, _data + e.bins + (2+j)*sizeof(uint64_t), sizeof(k));
+      if (k >= (e.nbins + page_size-1) / page_size)
+        detail::bad_binary("page past the last bin");
+      size += std::min(page_size, e.nbins - k*page_size);
+    }
+    if (size > _file.size() / e.bin_size)
+      detail::bad_binary("bins past the end of the file");
+    check_range(detail::binary_pad(e.bins + (2+npages)*sizeof(uint64_t)),
+      size*e.bin_size, "bins");
+  }
+
+  void check_blocks(const detail::binary_entry& e) const {
+    check_range(e.bins,2*sizeof(uint64_t),"block table");
+    uint64_t table[2];
+    std::memcpy(table, _data + e.bins, sizeof(table));
+    const auto [block, nblocks] = table;
+    if (block == 0 || nblocks != e.nbins / block + (e.nbins % block != 0)
+      || nblocks > _file.size() / sizeof(uint64_t))
+      detail::bad_binary("bad block table");
+    uint64_t end = (3 + nblocks)*sizeof(uint64_t);
+    check_range(e.bins,end,"block table");
+    for (uint64_t j=0; j<=nblocks; ++j) {
+      uint64_t off;
+      std::memcpy(&off, _data + e.bins + (2+j)*sizeof(uint64_t), sizeof(off));
+      if (off < end) detail::bad_binary("bad block table");
+      end = off;
+    }
+    check_range(e.bins,end,"blocks");
+  }
+
+public:
+  explicit binary_file(const std::string& path)
+  : _file(path), _data(_file.data())
+  {
+    if (_file.size() < sizeof(detail::binary_header))
+      detail::bad_binary(path+" is too short");
+    detail::binary_header head;
+    std::memcpy(&head,_data,sizeof(head));
+    _delta = !std::memcmp(head.magic,detail::binary_delta_magic,
+      sizeof(head.magic));
+    _compressed = !std::memcmp(head.magic,detail::binary_compressed_magic,
+      sizeof(head.magic));
+    if (!_delta && !_compressed &&
+      std::memcmp(head.magic,detail::binary_magic,sizeof(head.magic)))
+      detail::bad_binary("not a histogram file");
+    if (head.byte_order != detail::binary_byte_order)
+      detail::bad_binary("wrong byte order");
+    if (head.version != detail::binary_version)
+      detail::bad_binary("unsupported version "+std::to_string(head.version));
+    if (head.nhists > _file.size() / sizeof(detail::binary_entry))
+      detail::bad_binary("index past the end of the file");
+    check_range(head.index,head.nhists*sizeof(detail::binary_entry),"index");
+    check_range(head.axes,head.axes_size,"axes");
+    check_range(head.bins,head.bins_size,"bin definitions");
+    _axes = nlohmann::json::parse(
+      _data + head.axes, _data + head.axes + head.axes_size );
+    _bins = nlohmann::json::parse(
+      _data + head.bins, _data + head.bins + head.bins_size );
+    _index.resize(head.nhists);
+    std::memcpy(_index.data(), _data + head.index,
+      _index.size()*sizeof(detail::binary_entry));
+    for (const auto& e : _index) {
+      check_range(e.name,e.name_size,"name");
+      check_range(e.axes,uint64_t(e.naxes)*sizeof(uint32_t),"axes");
+      if (e.bin_size == 0) detail::bad_binary("zero bin size");
+      if (_delta) check_delta(e);
+      else if (_compressed) check_blocks(e);
+      else {
+        if (e.nbins > _file.size() / e.bin_size)
+          detail::bad_binary("bins past the end of the file");
+        check_range(e.bins,e.nbins*e.bin_size,"bins");
+      }
+    }
+  }
+
+  // true if the file is a delta checkpoint
+  bool delta() const noexcept { return _delta; }
+  // true if the bins are compressed
+  bool compressed() const noexcept { return _compressed; }
+
+  // number of threads that decompress the blocks of a histogram,
+  // 1 by default, all cores if 0
+  binary_file& threads(unsigned n) noexcept {
+    _threads = n;
+    return *this;
+  }
+
+  size_t size() const noexcept { return _index.size(); }
+  std::string_view name(size_t i) const {
+    const auto& e = _index.at(i);
+    return { _data + e.name, e.name_size };
+  }
+  // index of the histogram, or size() if there is none
+  size_t find(std::string_view name) const {
+    size_t a = 0, b = size();
+    while (a < b) {
+      const size_t m = a + (b-a)/2;
+      if (this->name(m) < name) a = m+1;
+      else b = m;
+    }
+    return a < size() && this->name(a) == name ? a : size();
+  }
+
+  const nlohmann::json& axes() const noexcept { return _axes; }
+  const nlohmann::json& bin_defs() const noexcept { return _bins; }
+
+  template <Histogram H>
+  H get(size_t i) const {
+    H h;
+    read(_index.at(i),h);
+    return h;
+  }
+  template <Histogram H>
+  H get(std::string_view name) const {
+    const size_t i = find(name);
+    if (i == size())
+      detail::bad_binary("no histogram \""+std::string(name)+"\"");
+    return get<H>(i);
+  }
+
+  // Same as from_json() for a dictionary.
+  // A delta checkpoint overwrites only the pages it holds.
+  template <HistogramDict Dict>
+  void get(Dict& hs) const {
+    using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
+    for (size_t i=0; i<size(); ++i) {
+      const std::string name(this->name(i));
+      auto it = hs.find(name);
+      if (it == hs.end()) {
+        if constexpr (std::is_constructible_v<
+          typename Dict::mapped_type, std::unique_ptr<hist_t>
+        >) it = hs.emplace(name,std::make_unique<hist_t>()).first;
+        else detail::bad_binary(
+          "no histogram \""+name+"\" in the dictionary");
+      }
+      if (_delta) read_delta(_index[i],*std::get<1>(*it));
+      else read(_index[i],*std::get<1>(*it));
+    }
+  }
+};
+
+// Replays a base checkpoint and its deltas, in order,
+// and writes the result as a single full checkpoint.
+template <HistogramDict Dict>
+void compact_binary(
+  std::span<const std::string> checkpoints, const std::string& out
+) {
+  Dict hs;
+  for (const auto& path : checkpoints)
+    binary_file(path).get(hs);
+  write_binary(out,hs);
+}
+
+} // end namespace ivanp::hist
+
+#endif
+#endif
@@ -2,9 +2,59 @@
 #define IVANP_HISTOGRAMS_BINS_HH
 
 #include <cmath>
+#include <array>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
 
 namespace ivanp::hist {
 
+namespace detail {
+
+// number of independent partial sums in batch accumulation
+// lanes let the loops vectorize without reassociating additions
+inline constexpr unsigned batch_lanes = 8;
+
+// https://en.wikipedia.org/wiki/Kahan_summation_algorithm
+template <typename T>
+[[gnu::always_inline]]
+inline void neumaier_add(T& sum, T& c, T x) noexcept {
+  const T t = sum + x;
+  const bool ge = std::abs(sum) >= std::abs(x);
+  const T big = ge ? sum : x, small = ge ? x : sum;
+  c += (big - t) + small;
+  sum = t;
+}
+
+} // end namespace detail
+
+template <typename T = double>
+struct compensated {
+  using value_type = T;
+
+  value_type sum = 0, c = 0;
+
+  compensated& operator++() noexcept {
+    detail::neumaier_add<value_type>(sum,c,1);
+    return *this;
+  }
+  compensated& operator+=(value_type x) noexcept {
+    detail::neumaier_add(sum,c,x);
+    return *this;
+  }
+  compensated& operator+=(const compensated<auto>& o) noexcept {
+    detail::neumaier_add<value_type>(sum,c,o.sum);
+    c += o.c;
+    return *this;
+  }
+
+  value_type value() const noexcept { return sum + c; }
+  operator value_type() const noexcept { return value(); }
+};
+
 template <typename Weight = double>
 struct ww2_bin {
   using weight_type = Weight;
@@ -27,6 +77,65 @@ struct ww2_bin {
     w2 += o.w2;
     return *this;
   }
+
+  ww2_bin& accumulate(std::span<const weight_type> ws) noexcept {
+    constexpr unsigned L = detail::batch_lanes;
+    weight_type s[L] { }, s2[L] { };
+    const size_t n = ws.size(), m = n - n%L;
+    for (size_t i=0; i<m; i+=L)
+      for (unsigned l=0; l<L; ++l) {
+        const weight_type x = ws[i+l];
+        s [l] += x;
+        s2[l] += x*x;
+      }
+    for (size_t i=m; i<n; ++i) *this += ws[i];
+    for (unsigned l=0; l<L; ++l) {
+      w  += s [l];
+      w2 += s2[l];
+    }
+    return *this;
+  }
+};
+
+template <typename Weight = double>
+struct compensated_ww2_bin {
+  using weight_type = Weight;
+
+  compensated<weight_type> w, w2;
+  compensated_ww2_bin& operator++() noexcept {
+    ++w;
+    ++w2;
+    return *this;
+  }
+  compensated_ww2_bin& operator+=(weight_type weight) noexcept {
+    w  += weight;
+    w2 += weight*weight;
+    return *this;
+  }
+  compensated_ww2_bin& operator+=(const compensated_ww2_bin<auto>& o)
+  noexcept {
+    w  += o.w;
+    w2 += o.w2;
+    return *this;
+  }
+
+  compensated_ww2_bin& accumulate(std::span<const weight_type> ws) noexcept {
+    constexpr unsigned L = detail::batch_lanes;
+    weight_type s[L] { }, c[L] { }, s2[L] { }, c2[L] { };
+    const size_t n = ws.size(), m = n - n%L;
+    for (size_t i=0; i<m; i+=L)
+      for (unsigned l=0; l<L; ++l) {
+        const weight_type x = ws[i+l];
+        detail::neumaier_add(s [l],c [l],x);
+        detail::neumaier_add(s2[l],c2[l],x*x);
+      }
+    for (size_t i=m; i<n; ++i) *this += ws[i];
+    for (unsigned l=0; l<L; ++l) {
+      w  += compensated<weight_type>{ s [l], c [l] };
+      w2 += compensated<weight_type>{ s2[l], c2[l] };
+    }
+    return *this;
+  }
 };
 
 template <typename Weight = double, typename Count = long unsigned>
@@ -56,55 +165,159 @@ struct mc_bin {
     n += o.n;
     return *this;
   }
+
+  mc_bin& accumulate(std::span<const weight_type> ws) noexcept {
+    ww2_bin<weight_type> b;
+    b.accumulate(ws);
+    w  += b.w;
+    w2 += b.w2;
+    n += ws.size();
+    return *this;
+  }
+};
+
+template <typename Weight = double, typename Count = long unsigned>
+struct compensated_mc_bin {
+  using weight_type = Weight;
+  using count_type = Count;
+
+  compensated<weight_type> w, w2;
+  count_type n = 0;
+  compensated_mc_bin& operator++() noexcept {
+    ++w;
+    ++w2;
+    ++n;
+    return *this;
+  }
+  compensated_mc_bin& operator+=(weight_type weight) noexcept {
+    w  += weight;
+    w2 += weight*weight;
+    ++n;
+    return *this;
+  }
+  compensated_mc_bin& operator+=(const compensated_mc_bin<auto,auto>& o)
+  noexcept {
+    w  += o.w;
+    w2 += o.w2;
+    n += o.n;
+    return *this;
+  }
+
+  compensated_mc_bin& accumulate(std::span<const weight_type> ws) noexcept {
+    compensated_ww2_bin<weight_type> b;
+    b.accumulate(ws);
+    w  += b.w;
+    w2 += b.w2;
+    n += ws.size();
+    return *this;
+  }
 };
 
 template <unsigned MaxMoment=2>
 struct stat_bin {
+  static_assert(MaxMoment <= 4, "stat_bin supports up to 4 moments");
+  using moments_type = std::array<double,MaxMoment+1>;
+
   long unsigned n = 0;
-  std::array<double,MaxMoment+1> m { }; // moments' accumulators
-  // 0: total
+  moments_type m { }; // moments' accumulators
+  // 0: total weight
   // 1: mean
-  // 2: variance
-  // 3: skewness
-  // 4: kurtosis
+  // 2: sum of squared deviations from the mean
+  // 3: sum of cubed deviations from the mean
+  // 4: sum of 4th powers of deviations from the mean
 
   // https://www.johndcook.com/blog/skewness_kurtosis/
+  // https://www.osti.gov/biblio/1028931 (Pebay, weighted pairwise updates)
 
-  void operator()(double x) noexcept {
-    ++m[0];
+  // combine with the accumulators of another sample
+  void merge(const moments_type& b) noexcept {
+    const double wa = m[0], wb = b[0], w = wa + wb;
+    m[0] = w;
     if constexpr (MaxMoment > 0) {
-      if (n == 0) {
-        m[1] = x;
-      } else {
-        const double d = x-m[1];
-        m[1] += d/m[0];
-        if constexpr(MaxMoment > 1) {
-          m[2] += d*(x-m[1]);
-        }
+      if (w == 0) return;
+      const double d = b[1] - m[1], dw = d*wb/w;
+      m[1] += dw;
+      if constexpr (MaxMoment > 1) {
+        const double d2 = d*dw*wa; // d^2 wa wb / w
+        if constexpr (MaxMoment > 3)
+          m[4] += b[4] + ( d2*d*d*(wa*wa - wa*wb + wb*wb)
+                         + 6*d*d*(wa*wa*b[2] + wb*wb*m[2]) )/(w*w)
+                       + 4*d*(wa*b[3] - wb*m[3])/w;
+        if constexpr (MaxMoment > 2)
+          m[3] += b[3] + (d2*d*(wa - wb) + 3*d*(wa*b[2] - wb*m[2]))/w;
+        m[2] += b[2] + d2;
       }
     }
-    ++n;
   }
+
   void operator()(double x, double weight) noexcept {
-    m[0] += weight;
+    moments_type b { };
+    b[0] = weight;
+    if constexpr (MaxMoment > 0) b[1] = x;
+    merge(b);
+    ++n;
+  }
+  void operator()(double x) noexcept { (*this)(x,1.); }
+
+  // batch updates compute the batch moments about the batch mean
+  // and merge them in once, with only a couple of divisions per batch
+  void operator()(std::span<const double> xs) noexcept {
+    if (xs.empty()) return;
+    moments_type b { };
+    b[0] = xs.size();
     if constexpr (MaxMoment > 0) {
-      if (n == 0) {
-        m[1] = x;
-      } else {
-        const double wd = weight*(x-m[1]);
-        m[1] += wd/m[0];
-        if constexpr(MaxMoment > 1) {
-          m[2] += wd*(x-m[1]);
+      for (double x : xs) b[1] += x;
+      b[1] /= b[0];
+      if constexpr (MaxMoment > 1)
+        for (double x : xs) {
+          const double d = x - b[1], d2 = d*d;
+          b[2] += d2;
+          if constexpr (MaxMoment > 2) b[3] += d2*d;
+          if constexpr (MaxMoment > 3) b[4] += d2*d2;
         }
-      }
     }
-    ++n;
+    merge(b);
+    n += xs.size();
+  }
+  void operator()(
+    std::span<const double> xs, std::span<const double> ws
+  ) noexcept {
+    const size_t nx = std::min(xs.size(),ws.size());
+    if (nx == 0) return;
+    moments_type b { };
+    for (size_t i=0; i<nx; ++i) {
+      b[0] += ws[i];
+      if constexpr (MaxMoment > 0) b[1] += ws[i]*xs[i];
+    }
+    n += nx;
+    if constexpr (MaxMoment > 0) {
+      if (b[0] == 0) return; // entries counted, no moments to update
+      b[1] /= b[0];
+      if constexpr (MaxMoment > 1)
+        for (size_t i=0; i<nx; ++i) {
+          const double d = xs[i] - b[1], wd2 = ws[i]*d*d;
+          b[2] += wd2;
+          if constexpr (MaxMoment > 2) b[3] += wd2*d;
+          if constexpr (MaxMoment > 3) b[4] += wd2*d*d;
+        }
+    }
+    merge(b);
+  }
+
+  stat_bin& operator+=(const stat_bin& o) noexcept {
+    merge(o.m);
+    n += o.n;
+    return *this;
   }
 
   template <unsigned I>
   double moment() const noexcept {
     if constexpr (I==2)
       return (n > 1) ? n*m[2]/((n-1)*m[0]) : 0.;
+    else if constexpr (I==3)
+      return m[2] != 0 ? std::sqrt(m[0])*m[3]/std::pow(m[2],1.5) : 0.;
+    else if constexpr (I==4)
+      return m[2] != 0 ? m[0]*m[4]/(m[2]*m[2]) - 3. : 0.;
     else
       return std::get<I>(m);
   }
@@ -118,6 +331,160 @@ struct stat_bin {
   double stdev    () const noexcept { return std::sqrt(variance()); }
 };
 
+template <typename Weight = double>
+struct profile_bin {
+  using weight_type = Weight;
+
+  weight_type w = 0, w2 = 0, wy = 0, wy2 = 0;
+  profile_bin& operator()(weight_type y) noexcept {
+    ++w;
+    ++w2;
+    wy  += y;
+    wy2 += y*y;
+    return *this;
+  }
+  profile_bin& operator()(weight_type y, weight_type weight) noexcept {
+    const weight_type wyi = weight*y;
+    w   += weight;
+    w2  += weight*weight;
+    wy  += wyi;
+    wy2 += wyi*y;
+    return *this;
+  }
+  profile_bin& operator+=(const profile_bin<auto>& o) noexcept {
+    w   += o.w;
+    w2  += o.w2;
+    wy  += o.wy;
+    wy2 += o.wy2;
+    return *this;
+  }
+
+  weight_type mean() const noexcept { return w != 0 ? wy/w : 0; }
+  weight_type variance() const noexcept {
+    if (w == 0) return 0;
+    const weight_type m = wy/w, v = wy2/w - m*m;
+    return v > 0 ? v : 0;
+  }
+  weight_type stdev() const noexcept { return std::sqrt(variance()); }
+  weight_type neff() const noexcept { return w2 != 0 ? w*w/w2 : 0; }
+  weight_type error() const noexcept {
+    const weight_type n = neff();
+    return n > 0 ? std::sqrt(variance()/n) : 0;
+  }
+};
+
+// Merging t-digest for quantiles of a secondary variable
+// https://arxiv.org/abs/1902.04023
+// Incoming values are buffered and merged into at most ~Compression
+// centroids when the buffer fills up, so memory per bin is bounded.
+template <unsigned Compression = 100>
+struct tdigest_bin {
+  struct centroid {
+    double mean, w;
+  };
+  static constexpr double compression = Compression;
+  static constexpr size_t buffer_size = 5*Compression;
+
+private:
+  mutable std::vector<centroid> _c; // merged, sorted by mean
+  mutable std::vector<centroid> _buf; // unmerged
+  double _w = 0,
+    _min = std::numeric_limits<double>::infinity(),
+    _max = -std::numeric_limits<double>::infinity();
+
+public:
+  long unsigned n = 0;
+
+  // k1 scale function
+  static double k(double q) noexcept {
+    return (compression/(2*std::numbers::pi))*std::asin(2*q-1);
+  }
+  static double k_inv(double k) noexcept {
+    return k >= compression/4 ? 1
+      : (std::sin(k*(2*std::numbers::pi/compression))+1)/2;
+  }
+
+  void compress() const {
+    if (_buf.empty()) return;
+    _buf.insert(_buf.end(), _c.begin(), _c.end());
+    std::sort(_buf.begin(), _buf.end(),
+      [](const centroid& a, const centroid& b){ return a.mean < b.mean; });
+    double w = 0;
+    for (const auto& c : _buf) w += c.w;
+    _c.clear();
+    if (!(w > 0)) {
+      _buf.clear();
+      return;
+    }
+    auto it = _buf.begin();
+    centroid cur = *it;
+    double q0 = 0, qmax = k_inv(k(q0)+1);
+    for (const auto end = _buf.end(); ++it != end; ) {
+      if (q0 + (cur.w + it->w)/w <= qmax) {
+        cur.w += it->w;
+        cur.mean += (it->mean - cur.mean)*(it->w/cur.w);
+      } else {
+        _c.push_back(cur);
+        q0 += cur.w/w;
+        qmax = k_inv(k(q0)+1);
+        cur = *it;
+      }
+    }
+    _c.push_back(cur);
+    _buf.clear();
+  }
+
+  void operator()(double x, double weight) {
+    if (_buf.capacity() == 0) _buf.reserve(buffer_size);
+    _buf.push_back({x,weight});
+    _w += weight;
+    if (x < _min) _min = x;
+    if (x > _max) _max = x;
+    ++n;
+    if (_buf.size() >= buffer_size) compress();
+  }
+  void operator()(double x) { (*this)(x,1.); }
+
+  tdigest_bin& operator+=(const tdigest_bin& o) {
+    o.compress();
+    _buf.insert(_buf.end(), o._c.begin(), o._c.end());
+    _w += o._w;
+    if (o._min < _min) _min = o._min;
+    if (o._max > _max) _max = o._max;
+    n += o.n;
+    compress();
+    return *this;
+  }
+
+  const std::vector<centroid>& centroids() const {
+    compress();
+    return _c;
+  }
+
+  double total() const noexcept { return _w; }
+  double min() const noexcept { return _min; }
+  double max() const noexcept { return _max; }
+
+  double quantile(double q) const {
+    const auto& c = centroids();
+    if (c.empty()) return std::numeric_limits<double>::quiet_NaN();
+    if (c.size() == 1) return c.front().mean;
+    const double x = q*_w;
+    double s = c.front().w/2; // cumulative weight at the centroid's center
+    if (x < s) return _min + (c.front().mean - _min)*(x/s);
+    for (size_t i=1, n=c.size(); i<n; ++i) {
+      const double dw = (c[i-1].w + c[i].w)/2;
+      if (x < s + dw)
+        return c[i-1].mean + (c[i].mean - c[i-1].mean)*((x - s)/dw);
+      s += dw;
+    }
+    const double half = c.back().w/2;
+    return c.back().mean
+      + (_max - c.back().mean)*std::min((x - s)/half, 1.);
+  }
+  double median() const { return quantile(0.5); }
+};
+
 struct nlo_mc_multibin {
   std::vector<ww2_bin<double>> ww2;
   std::vector<double> wsum;
@@ -6,6 +6,10 @@
 #include <array>
 #include <vector>
 #include <string>
+#include <span>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
 
 #include <ivanp/cont/general.hh>
 #include <ivanp/cont/map.hh>
@@ -29,6 +33,20 @@ namespace ivanp::hist {
 
 namespace detail {
 
+// Bin count arithmetic checked against overflow of index_type.
+// Checking the total number of bins when it is computed
+// makes every index_type within the histogram valid.
+inline index_type checked_mul(index_type a, index_type b) {
+  if (b != 0 && a > std::numeric_limits<index_type>::max()/b)
+    throw std::length_error("number of histogram bins overflows index_type");
+  return a*b;
+}
+inline index_type checked_add(index_type a, index_type b) {
+  if (a > std::numeric_limits<index_type>::max()-b)
+    throw std::length_error("number of histogram bins overflows index_type");
+  return a+b;
+}
+
 template <typename Axes, bool perbin_axes>
 struct coord_arg { };
 
@@ -71,6 +89,39 @@ concept ValidCoordArg = requires {
   typename coord_arg<Axes,perbin_axes>::type;
 };
 
+template <typename Axis>
+concept GrowableAxis = requires (Axis& a, axis_edge_type<Axis> x) {
+  { get_axis_ref(a).grow(x) } -> std::same_as<axis_growth>;
+};
+
+template <typename Axes>
+struct has_growable_axes: std::false_type { };
+
+template <typename Axes>
+requires requires { typename Axes::value_type; }
+struct has_growable_axes<Axes>
+: std::bool_constant< GrowableAxis<typename Axes::value_type> > { };
+
+template <typename... Axes>
+struct has_growable_axes<std::tuple<Axes...>>
+: std::bool_constant< (GrowableAxis<Axes> || ...) > { };
+
+template <typename Axes>
+struct has_noflow_axes: std::false_type { };
+
+template <typename Axes>
+requires requires { typename Axes::value_type; }
+struct has_noflow_axes<Axes>
+: std::bool_constant< NoflowAxis<
+    decltype(get_axis_ref(std::declval<typename Axes::value_type&>())) > >
+{ };
+
+template <typename... Axes>
+struct has_noflow_axes<std::tuple<Axes...>>
+: std::bool_constant< (NoflowAxis<
+    decltype(get_axis_ref(std::declval<Axes&>())) > || ...) >
+{ };
+
 } // end namespace detail
 
 namespace impl {
@@ -90,6 +141,16 @@ public:
   using bins_type = Bins;
   using filler_type = Filler;
   static constexpr bool perbin_axes = !!(flags & hist_flags::perbin_axes);
+  static constexpr bool growable = !perbin_axes &&
+    detail::has_growable_axes<std::remove_cvref_t<axes_type>>::value;
+  // fills outside of axes without flow bins go to an extra last bin
+  static constexpr bool noflow = !perbin_axes &&
+    detail::has_noflow_axes<std::remove_cvref_t<axes_type>>::value;
+  // false for read-only bins, e.g. in a histogram_view
+  static constexpr bool mutable_bins =
+    requires (bins_type& b, index_type i) {
+      { cont::at(b,i) } -> std::same_as<bin_type&>;
+    };
 
 private:
   axes_type _axes;
@@ -110,7 +171,7 @@ private:
       index_type n = 1;
       if constexpr (!perbin_axes) {
         cont::map([&n](const auto& a) {
-          n *= get_axis_ref(a).nbins();
+          n = detail::checked_mul(n,get_axis_ref(a).nbins());
         }, _axes);
       } else {
         cont::map([&]<typename D>(const D& dim) {
@@ -123,10 +184,12 @@ private:
           n = 0;
           auto it = std::begin(dim);
           for (index_type k = 0; k<j; ++k, ++it)
-            n += get_axis_ref(*it).nbins();
-          n += dj * (get_axis_ref(*it).nbins());
+            n = detail::checked_add(n,get_axis_ref(*it).nbins());
+          n = detail::checked_add(n,
+            detail::checked_mul(dj,get_axis_ref(*it).nbins()));
         }, _axes);
       }
+      if constexpr (noflow) n = detail::checked_add(n,1);
       if constexpr (sizeof...(bin_args)==0) {
         if constexpr (can_resize) _bins.resize(n);
       } else {
@@ -148,6 +211,42 @@ private:
     }
   }
 
+  // move bins to the layout of grown axes
+  void relayout(const std::vector<axis_growth>& g) {
+    const size_t nd = g.size();
+    std::vector<index_type> n_old(nd), n_new(nd);
+    index_type n = 1;
+    { size_t d = 0;
+      cont::map([&](const auto& a) {
+        n = detail::checked_mul(n, n_new[d] = get_axis_ref(a).nbins());
+        n_old[d] = n_new[d] - g[d].below - g[d].above;
+        ++d;
+      }, _axes);
+    }
+    bins_type bins;
+    bins.resize(detail::checked_add(n,noflow));
+    std::vector<index_type> ii(nd);
+    index_type nk = cont::size(_bins);
+    const auto move_bin = [&](index_type j, index_type k) {
+      if constexpr (requires { bins.move_bin(j,_bins,k); })
+        bins.move_bin(j,_bins,k); // storage with separate totals
+      else
+        bins[j] = std::move(_bins[k]);
+    };
+    if constexpr (noflow) move_bin(n,--nk);
+    for (index_type k=0; k<nk; ++k) {
+      index_type j = 0;
+      for (size_t d=0; d<nd; ++d)
+        (j *= n_new[d]) += g[d](ii[d],n_old[d]);
+      move_bin(j,k);
+      for (size_t d=nd; d--; ) { // the last axis is the innermost
+        if (++ii[d] < n_old[d]) break;
+        ii[d] = 0;
+      }
+    }
+    _bins = std::move(bins);
+  }
+
 public:
   histogram() = default;
   histogram(const histogram&) = default;
@@ -247,26 +346,30 @@ public:
     return join_index(std::array<index_type,sizeof...(I)>{index_type(i)...});
   }
 
-  const bin_type& bin_at(index_type i) const { return cont::at(_bins,i); }
-  bin_type& bin_at(index_type i) { return cont::at(_bins,i); }
+  // const access returns what the storage returns, e.g. folded totals
+  decltype(auto) bin_at(index_type i) const { return cont::at(_bins,i); }
+  bin_type& bin_at(index_type i) requires mutable_bins {
+    return cont::at(_bins,i);
+  }
 
-  const bin_type& bin_at(std::initializer_list<index_type> ii) const {
+  decltype(auto) bin_at(std::initializer_list<index_type> ii) const {
     return bin_at(join_index(ii));
   }
-  bin_type& bin_at(std::initializer_list<index_type> ii) {
+  bin_type& bin_at(std::initializer_list<index_type> ii)
+  requires mutable_bins {
     return bin_at(join_index(ii));
   }
   template <typename... T>
-  const bin_type& bin_at(const T&... ii) const {
+  decltype(auto) bin_at(const T&... ii) const {
     return bin_at(join_index(ii...));
   }
   template <typename... T>
-  bin_type& bin_at(const T&... ii) {
+  bin_type& bin_at(const T&... ii) requires mutable_bins {
     return bin_at(join_index(ii...));
   }
 
   template <typename T = std::initializer_list<index_type>>
-  const bin_type& operator[](const T& ii) const {
+  decltype(auto) operator[](const T& ii) const {
     const index_type i = join_index(ii);
     if constexpr (cont::Sizable<bins_type>)
       if (i >= _bins.size()) [[unlikely]]
@@ -274,7 +377,7 @@ public:
     return bin_at(i);
   }
   template <typename T = std::initializer_list<index_type>>
-  bin_type& operator[](const T& ii) {
+  bin_type& operator[](const T& ii) requires mutable_bins {
     const index_type i = join_index(ii);
     if constexpr (cont::Sizable<bins_type>)
       if (i >= _bins.size()) [[unlikely]]
@@ -287,7 +390,19 @@ public:
   index_type find_bin_index(const cont::Container auto& xs) const {
     // N = (a*nb + b)*nc + c
     index_type index = 0;
-    if constexpr (!perbin_axes) {
+    if constexpr (noflow) {
+      // select the extra bin without branching
+      index_type n = 1;
+      bool out = false;
+      cont::map([&](const auto& x, const auto& _a) {
+        const auto& a = get_axis_ref(_a);
+        const index_type nb = a.nbins(), i = a.find_bin_index(x);
+        if constexpr (NoflowAxis<decltype(a)>) out |= !(i < nb);
+        (index *= nb) += i;
+        n *= nb;
+      }, xs, _axes);
+      index = out ? n : index;
+    } else if constexpr (!perbin_axes) {
       cont::map([&](const auto& x, const auto& _a) {
         const auto& a = get_axis_ref(_a);
         (index *= a.nbins()) += a.find_bin_index(x);
@@ -317,17 +432,100 @@ public:
     return find_bin_index(std::forward_as_tuple(xs...));
   }
 
+  // Bin indices for columns of coordinates, one column per axis.
+  // Axes are looked up a chunk of rows at a time with their batch kernels.
+  void find_bin_indices(
+    const cont::Container auto& cols, std::span<index_type> out
+  ) const requires(!perbin_axes) {
+    const size_t n = out.size();
+    cont::map([n](const auto& col) {
+      if (std::size(col) < n) throw std::length_error(
+        "coordinate column is shorter than the output");
+    }, cols);
+    for (size_t k=0; k<n; k+=chunk)
+      find_chunk_indices(cols, k, out.subspan(k,std::min(chunk,n-k)));
+  }
+
+private:
+  static constexpr size_t chunk = 256;
+
+  // Bin indices for rows [k,k+o.size()) of the columns, o.size() <= chunk
+  void find_chunk_indices(
+    const cont::Container auto& cols, size_t k, std::span<index_type> o
+  ) const {
+    const size_t m = o.size();
+    index_type ii[chunk];
+    [[maybe_unused]] bool outside[chunk];
+    std::fill(o.begin(),o.end(),0);
+    if constexpr (noflow) std::fill_n(outside,m,false);
+    [[maybe_unused]] index_type total = 1;
+    cont::map([&](const auto& col, const auto& _a) {
+      const auto& a = get_axis_ref(_a);
+      using T = std::remove_cvref_t<decltype(*std::data(col))>;
+      hist::find_bin_indices(a,
+        std::span<const T>(std::data(col)+k,m), std::span(ii,m));
+      const index_type nb = a.nbins();
+      if constexpr (NoflowAxis<decltype(a)>)
+        for (size_t i=0; i<m; ++i)
+          outside[i] |= !(ii[i] < nb);
+      for (size_t i=0; i<m; ++i)
+        (o[i] *= nb) += ii[i];
+      if constexpr (noflow) total *= nb;
+    }, cols, _axes);
+    if constexpr (noflow)
+      for (size_t i=0; i<m; ++i)
+        o[i] = outside[i] ? total : o[i];
+  }
+
+public:
+  // Bin counting fills outside of the axes without flow bins
+  decltype(auto) outside_bin() const requires noflow {
+    return bin_at(cont::size(_bins)-1);
+  }
+  bin_type& outside_bin() requires noflow && mutable_bins {
+    return bin_at(cont::size(_bins)-1);
+  }
+
   template <typename... T>
-  const bin_type& find_bin(const T&... xs) const {
+  decltype(auto) find_bin(const T&... xs) const {
     return bin_at(find_bin_index(xs...));
   }
   template <typename... T>
-  bin_type& find_bin(const T&... xs) {
+  bin_type& find_bin(const T&... xs) requires mutable_bins {
+    if constexpr (growable) grow(xs...);
     return bin_at(find_bin_index(xs...));
   }
 
   // ----------------------------------------------------------------
 
+  // Extend growable axes to include the coordinates.
+  // Returns true if any axis grew and the bins were rearranged.
+  bool grow(const cont::Container auto& xs) requires growable {
+    std::vector<axis_growth> g;
+    size_t d = 0;
+    cont::map([&](const auto& x, auto& _a) {
+      auto& a = get_axis_ref(_a);
+      if constexpr (requires { a.grow(x); }) {
+        if (const axis_growth ag = a.grow(x)) {
+          if (g.empty()) g.resize(ndim());
+          g[d] = ag;
+        }
+      }
+      ++d;
+    }, xs, _axes);
+    if (g.empty()) return false;
+    relayout(g);
+    return true;
+  }
+
+  template <typename... T>
+  requires (sizeof...(T) != 1) || (!cont::Container<head_t<T...>>)
+  bool grow(const T&... xs) requires growable {
+    return grow(std::forward_as_tuple(xs...));
+  }
+
+  // ----------------------------------------------------------------
+
   template <typename I = std::initializer_list<index_type>, typename... Args>
   decltype(auto) fill_at(const I& ii, Args&&... args) {
     return filler_type::fill(bin_at(ii),std::forward<Args>(args)...);
@@ -373,6 +571,31 @@ public:
     return fill(xs,std::forward<Args>(args)...);
   }
 
+  // Fills every row of columns of coordinates, one column per axis,
+  // passing the same args to each fill.
+  // Bin indices are found a chunk of rows at a time by the axes' batch
+  // lookups, so hinted_axis merges sorted columns with its edges.
+  template <typename... Args>
+  void fill_batch(const cont::Container auto& cols, const Args&... args)
+  requires(!perbin_axes) {
+    size_t n = 0;
+    bool first = true;
+    cont::map([&](const auto& col) {
+      if (first) {
+        first = false;
+        n = std::size(col);
+      } else if (std::size(col) != n) throw std::length_error(
+        "coordinate columns of unequal size");
+    }, cols);
+    index_type ii[chunk];
+    for (size_t k=0; k<n; k+=chunk) {
+      const size_t m = std::min(chunk,n-k);
+      find_chunk_indices(cols, k, std::span(ii,m));
+      for (size_t i=0; i<m; ++i)
+        filler_type::fill(bin_at(ii[i]),args...);
+    }
+  }
+
 };
 
 } // end namespace impl
@@ -449,6 +672,61 @@ struct is_histogram<impl::histogram<Bin,Axes,Bins,Filler,flags>>
 template <typename T>
 concept Histogram = is_histogram<std::decay_t<T>>::value;
 
+// Batch fill of a 1D profile histogram
+// Works with any bin type that has w, w2, wy, and wy2 members,
+// such as profile_bin from bins.hh.
+// The bin indices and the weighted products are computed in chunks by
+// loops that vectorize, leaving only the scatter into the bins scalar.
+// Empty ws means unit weights.
+template <Histogram H>
+requires (!H::perbin_axes)
+void fill_profile(
+  H& h,
+  std::span<const axis_edge_type<cont::first_type<typename H::axes_type>>> xs,
+  std::span<const typename H::bin_type::weight_type> ys,
+  std::span<const typename H::bin_type::weight_type> ws = { }
+) {
+  using weight_type = typename H::bin_type::weight_type;
+  if (h.ndim() != 1) throw std::invalid_argument(
+    "fill_profile() requires a 1D histogram");
+  const size_t n = std::min(xs.size(),ys.size());
+  if (!ws.empty() && ws.size() < n) throw std::length_error(
+    "fill_profile() given fewer weights than values");
+  const auto& axis = get_axis_ref(cont::first(h.axes()));
+
+  constexpr size_t chunk = 256;
+  index_type ii[chunk];
+  weight_type w[chunk], w2[chunk], wy[chunk], wy2[chunk];
+  for (size_t k=0; k<n; k+=chunk) {
+    const size_t m = std::min(chunk,n-k);
+    axis.find_bin_indices(xs.subspan(k,m), std::span(ii,m));
+    const weight_type* y = ys.data()+k;
+    if (ws.empty()) {
+      for (size_t i=0; i<m; ++i) {
+        w[i] = 1;
+        w2[i] = 1;
+        wy[i] = y[i];
+        wy2[i] = y[i]*y[i];
+      }
+    } else {
+      const weight_type* wi = ws.data()+k;
+      for (size_t i=0; i<m; ++i) {
+        w[i] = wi[i];
+        w2[i] = wi[i]*wi[i];
+        wy[i] = wi[i]*y[i];
+        wy2[i] = wy[i]*y[i];
+      }
+    }
+    for (size_t i=0; i<m; ++i) {
+      auto& b = h.bin_at(ii[i]);
+      b.w   += w  [i];
+      b.w2  += w2 [i];
+      b.wy  += wy [i];
+      b.wy2 += wy2[i];
+    }
+  }
+}
+
 } // end namespace ivanp::hist
 
 #endif
@@ -5,6 +5,12 @@
 #error "must include histograms.hh first"
 #else
 
+#include <cstring>
+#include <iterator>
+#include <variant>
+#include <unordered_map>
+#include <memory>
+
 #include <nlohmann/json.hpp>
 
 // https://github.com/ivankp/histograms#histograms
@@ -22,6 +28,235 @@ void to_json(nlohmann::json& j, const cont_axis<Cont,Edge>& axis) {
   j = axis.edges();
 }
 
+template <typename Edge>
+void to_json(nlohmann::json& j, const uniform_axis<Edge>& axis) {
+  j = { { axis.min(), axis.max(), axis.ndiv() } };
+}
+
+template <typename Edge>
+void to_json(nlohmann::json& j, const log_uniform_axis<Edge>& axis) {
+  j = { { axis.min(), axis.max(), axis.ndiv(), "log" } };
+}
+
+template <typename Transform, typename Edge>
+void to_json(
+  nlohmann::json& j, const transformed_axis<Transform,Edge>& axis
+) {
+  j = { { axis.min(), axis.max(), axis.ndiv(), Transform::name } };
+}
+
+template <typename Int>
+void to_json(nlohmann::json& j, const integer_axis<Int>& axis) {
+  j = { { axis.min(), axis.max(), axis.ndiv() } };
+}
+
+template <typename Edge>
+void to_json(nlohmann::json& j, const growable_uniform_axis<Edge>& axis) {
+  j = { { axis.min(), axis.max(), axis.ndiv() } };
+}
+
+template <typename Label, bool Growable>
+void to_json(
+  nlohmann::json& j, const category_axis<Label,Growable>& axis
+) {
+  j = { { "categories", axis.labels() } };
+  // unused bins reserved by a growable axis
+  auto& labels = j["categories"];
+  for (index_type i=axis.nlabels(), n=axis.ndiv(); i<n; ++i)
+    labels.push_back(nullptr);
+}
+
+template <typename Axis>
+void to_json(nlohmann::json& j, const noflow_axis<Axis>& axis) {
+  j = { { "axis", axis.axis() }, { "flow", false } };
+}
+
+template <typename Axis>
+void to_json(nlohmann::json& j, const hinted_axis<Axis>& axis) {
+  j = axis.axis();
+}
+
+template <typename... Axes>
+void to_json(nlohmann::json& j, const variant_axis<Axes...>& axis) {
+  std::visit([&j](const auto& a){ j = a; }, *axis);
+}
+
+// from_json ========================================================
+
+namespace detail {
+
+[[noreturn]] inline void bad_json(const char* what) {
+  throw std::invalid_argument(std::string("histogram json: ")+what);
+}
+
+// null, as written for non-finite values, is read as NaN
+template <typename T>
+T json_number(const nlohmann::json& j) {
+  if constexpr (std::is_floating_point_v<T>)
+    if (j.is_null()) return std::numeric_limits<T>::quiet_NaN();
+  return j.get<T>();
+}
+
+// same as read_json() for a bin
+template <typename Bin>
+void bin_from_json(const nlohmann::json& j, Bin& b) {
+  if constexpr (std::is_arithmetic_v<Bin> && !std::is_same_v<Bin,bool>)
+    b = json_number<Bin>(j);
+  else
+    j.get_to(b);
+}
+
+// [ [ min, max, ndiv, flag ] ] form of an axis definition
+struct uniform_def {
+  double min, max;
+  index_type ndiv;
+  std::string flag;
+
+  uniform_def(const nlohmann::json& seg) {
+    if (!seg.is_array() || seg.size() < 3 || seg.size() > 4)
+      bad_json("expected [min,max,ndiv] axis definition");
+    min = seg[0].get<double>();
+    max = seg[1].get<double>();
+    ndiv = seg[2].get<index_type>();
+    if (seg.size() > 3) flag = seg[3].get<std::string>();
+  }
+};
+
+inline uniform_def single_uniform_def(const nlohmann::json& j) {
+  if (!j.is_array() || j.size() != 1)
+    bad_json("expected [[min,max,ndiv]] axis definition");
+  return uniform_def(j[0]);
+}
+
+// edges of an axis in any of the array forms, e.g. [[0,1,10],50]
+inline std::vector<double> edges_from_json(const nlohmann::json& j) {
+  if (!j.is_array()) bad_json("expected axis edges array");
+  std::vector<double> edges;
+  for (const auto& x : j) {
+    if (x.is_number()) {
+      edges.push_back(x.get<double>());
+      continue;
+    }
+    const uniform_def u(x);
+    const auto add = [&](const auto& axis) {
+      for (index_type i=0, n=axis.nedges(); i<n; ++i)
+        edges.push_back(axis.edge(i));
+    };
+    if (u.flag.empty()) {
+      for (index_type i=0; i<=u.ndiv; ++i)
+        edges.push_back(u.min + (u.max-u.min)*i/u.ndiv);
+    }
+    else if (u.flag == "log")
+      add(log_uniform_axis<double>(u.min,u.max,u.ndiv));
+    else if (u.flag == sqrt_transform::name)
+      add(transformed_axis<sqrt_transform>(u.min,u.max,u.ndiv));
+    else if (u.flag == asinh_transform::name)
+      add(transformed_axis<asinh_transform>(u.min,u.max,u.ndiv));
+    else if (u.flag == reciprocal_transform::name)
+      add(transformed_axis<reciprocal_transform>(u.min,u.max,u.ndiv));
+    else bad_json("unknown axis flag");
+  }
+  return edges;
+}
+
+} // end namespace detail
+
+template <typename Cont, typename Edge>
+void from_json(const nlohmann::json& j, cont_axis<Cont,Edge>& axis) {
+  axis = detail::edges_from_json(j);
+}
+
+template <typename Edge>
+void from_json(const nlohmann::json& j, uniform_axis<Edge>& axis) {
+  const auto u = detail::single_uniform_def(j);
+  if (!u.flag.empty()) detail::bad_json("unexpected axis flag");
+  axis = { Edge(u.min), Edge(u.max), u.ndiv };
+}
+
+template <typename Edge>
+void from_json(const nlohmann::json& j, log_uniform_axis<Edge>& axis) {
+  const auto u = detail::single_uniform_def(j);
+  if (u.flag != "log") detail::bad_json("expected log axis");
+  axis = { Edge(u.min), Edge(u.max), u.ndiv };
+}
+
+template <typename Transform, typename Edge>
+void from_json(
+  const nlohmann::json& j, transformed_axis<Transform,Edge>& axis
+) {
+  const auto u = detail::single_uniform_def(j);
+  if (u.flag != Transform::name)
+    detail::bad_json("axis transform does not match");
+  axis = { Edge(u.min), Edge(u.max), u.ndiv };
+}
+
+template <typename Int>
+void from_json(const nlohmann::json& j, integer_axis<Int>& axis) {
+  const auto u = detail::single_uniform_def(j);
+  const Int min = j[0][0].get<Int>(), max = j[0][1].get<Int>();
+  if (!u.flag.empty() || max < min || index_type(max-min) != u.ndiv)
+    detail::bad_json("expected one bin per integer");
+  axis = { min, max };
+}
+
+template <typename Edge>
+void from_json(const nlohmann::json& j, growable_uniform_axis<Edge>& axis) {
+  const auto u = detail::single_uniform_def(j);
+  if (!u.flag.empty()) detail::bad_json("unexpected axis flag");
+  axis = { Edge(u.min), Edge(u.max), u.ndiv };
+}
+
+template <typename Label, bool Growable>
+void from_json(const nlohmann::json& j, category_axis<Label,Growable>& axis) {
+  const auto& cats = j.at("categories");
+  std::vector<Label> labels;
+  for (const auto& x : cats) {
+    if (x.is_null()) break; // unused bins reserved by a growable axis
+    labels.push_back(x.get<Label>());
+  }
+  axis = { std::move(labels), index_type(cats.size()) };
+}
+
+template <typename Axis>
+void from_json(const nlohmann::json& j, noflow_axis<Axis>& axis) {
+  if (j.at("flow").get<bool>()) detail::bad_json("expected axis without flow");
+  axis = j.at("axis").get<Axis>();
+}
+
+template <typename Axis>
+void from_json(const nlohmann::json& j, hinted_axis<Axis>& axis) {
+  axis = j.get<Axis>();
+}
+
+namespace detail {
+
+template <typename>
+struct is_cont_axis: std::false_type { };
+template <typename Cont, typename Edge>
+struct is_cont_axis<cont_axis<Cont,Edge>>: std::true_type { };
+
+} // end namespace detail
+
+// The first alternative that can read j, except that cont_axis
+// alternatives are tried last, because they can read any array form,
+// and would expand uniform axes into edges.
+template <typename... Axes>
+void from_json(const nlohmann::json& j, variant_axis<Axes...>& axis) {
+  bool done = false;
+  const auto try_read = [&]<typename A>(bool cont) {
+    if (done || cont != detail::is_cont_axis<A>::value) return;
+    try {
+      A a = j.get<A>();
+      *axis = std::move(a);
+      done = true;
+    } catch (const nlohmann::json::exception&) {
+    } catch (const std::invalid_argument&) { }
+  };
+  for (bool cont : { false, true })
+    (try_read.template operator()<Axes>(cont), ...);
+  if (!done) detail::bad_json("axis does not match any variant alternative");
+}
+
 template <Histogram H>
 void to_json(nlohmann::json& j, const H& h) {
   j = { {"axes", h.axes()} };
@@ -29,45 +264,295 @@ void to_json(nlohmann::json& j, const H& h) {
   j["bins"] = { bin_def<bin_type>::def(), h.bins() };
 }
 
+// Sparse bins ======================================================
+// "bins": [ def, { "size": N, "runs": [ [ i, [ . . . ] ], . . . ] } ]
+// Each run lists consecutive bins starting at index i.
+// Bins that are not in any run are empty, i.e. default constructed.
+
+template <typename T>
+struct sparse_ref { const T& x; };
+
+// serialize the bins of a histogram, or of histograms in a dictionary,
+// in the sparse form
+template <typename T>
+sparse_ref<T> as_sparse(const T& x) noexcept { return { x }; }
+
+namespace detail {
+
+template <typename Bin>
+bool empty_bin(const Bin& b) noexcept {
+  if constexpr (std::equality_comparable<Bin>) {
+    return b == Bin{};
+  } else if constexpr (std::is_trivially_copyable_v<Bin>) {
+    // bins that only differ in padding are kept, which is harmless
+    static const Bin empty{};
+    return !std::memcmp(&b,&empty,sizeof(Bin));
+  } else return false;
+}
+
+// Calls f(i,first,last) for runs of bins [first,last) starting at index i.
+// Runs go on across single empty bins, which are shorter to write
+// than the start of a new run.
+template <Histogram H, typename F>
+void sparse_runs(const H& h, F&& f) {
+  auto first = h.begin(), last = first;
+  size_t i = 0, start = 0, nempty = 0;
+  bool in_run = false;
+  for (auto it = h.begin(), end = h.end(); it != end; ++it, ++i) {
+    if (!empty_bin(*it)) {
+      if (!in_run) {
+        in_run = true;
+        first = it;
+        start = i;
+      }
+      last = std::next(it);
+      nempty = 0;
+    } else if (in_run && ++nempty == 2) {
+      f(start,first,last);
+      in_run = false;
+    }
+  }
+  if (in_run) f(start,first,last);
+}
+
+template <Histogram H>
+nlohmann::json sparse_bins_json(const H& h) {
+  auto runs = nlohmann::json::array();
+  sparse_runs(h,[&](size_t i, auto first, auto last) {
+    auto& run = runs.emplace_back(
+      nlohmann::json::array({ i, nlohmann::json::array() }) )[1];
+    for (; first != last; ++first) run.push_back(*first);
+  });
+  return { { "size", size_t(h.nbins()) }, { "runs", std::move(runs) } };
+}
+
+} // end namespace detail
+
+template <Histogram H>
+void to_json(nlohmann::json& j, const sparse_ref<H>& s) {
+  j = { {"axes", s.x.axes()} };
+  using bin_type = typename H::bin_type;
+  j["bins"] = { bin_def<bin_type>::def(), detail::sparse_bins_json(s.x) };
+}
+
+namespace detail {
+
+// a definition, or its index in the global array
+inline const nlohmann::json& resolve_def(
+  const nlohmann::json& j, const nlohmann::json* defs
+) {
+  if (defs && j.is_number_integer()) return defs->at(j.get<size_t>());
+  return j;
+}
+
+template <typename Axes>
+Axes axes_from_json(const nlohmann::json& j, const nlohmann::json* defs) {
+  if (!j.is_array()) bad_json("expected axes array");
+  if constexpr (cont::Tuple<Axes>) {
+    constexpr size_t n = std::tuple_size_v<Axes>;
+    if (j.size() != n) bad_json("wrong number of axes");
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return Axes{ resolve_def(j[I],defs)
+        .template get<std::tuple_element_t<I,Axes>>()... };
+    }(std::make_index_sequence<n>{});
+  } else {
+    Axes axes;
+    for (const auto& a : j)
+      axes.push_back( resolve_def(a,defs)
+        .template get<typename Axes::value_type>() );
+    return axes;
+  }
+}
+
+// "bins": [ def, [ . . . ] ], rather than the abbreviated "bins": def
+inline bool has_bin_data(const nlohmann::json& b) {
+  return b.is_array() && b.size() == 2 && !b[0].is_string()
+      && (b[1].is_array() || b[1].is_object());
+}
+
+template <typename Bin>
+void check_bin_def(const nlohmann::json& def, const nlohmann::json* defs) {
+  if (resolve_def(def,defs) != bin_def<Bin>::def())
+    bad_json("bin definition does not match the bin type");
+}
+
+// Bin i to read into.
+// Storage that keeps the totals apart from the filled bins loads the totals.
+template <Histogram H>
+decltype(auto) load_bin(H& h, index_type i) {
+  if constexpr (requires { h.bins().master(i); })
+    return h.bins().master(i);
+  else
+    return h.bin_at(i);
+}
+
+// Histogram axes and bins from j.
+// Axis and bin definitions can be indices into the global arrays.
+template <Histogram H>
+void histogram_from_json(
+  const nlohmann::json& j, H& h,
+  const nlohmann::json* axes, const nlohmann::json* bins
+) {
+  using bin_type = typename H::bin_type;
+  h = H(axes_from_json<std::remove_cvref_t<typename H::axes_type>>(
+    j.at("axes"), axes ));
+  const auto& b = j.at("bins");
+  if (!has_bin_data(b)) {
+    check_bin_def<bin_type>(b,bins);
+    return;
+  }
+  check_bin_def<bin_type>(b[0],bins);
+  const auto& data = b[1];
+  const size_t n = h.nbins();
+  if (data.is_object()) { // sparse, the other bins stay empty
+    if (data.at("size").get<size_t>() != n)
+      bad_json("number of bins does not match the axes");
+    for (const auto& run : data.at("runs")) {
+      size_t i = run.at(0).get<size_t>();
+      const auto& rb = run.at(1);
+      if (i > n || rb.size() > n-i)
+        bad_json("sparse bins past the last bin");
+      for (const auto& x : rb)
+        bin_from_json(x,load_bin(h,i++));
+    }
+    return;
+  }
+  if (data.size() != n)
+    bad_json("number of bins does not match the axes");
+  for (size_t i=0; i<n; ++i)
+    bin_from_json(data[i],load_bin(h,i));
+}
+
+// pointer-like handle to an axis
+template <typename A>
+concept AxisHandle =
+  requires (const A& a) { (*a).nbins(); } &&
+  !requires (const A& a) { a.nbins(); };
+
+template <typename Axes>
+struct axis_handles: std::false_type { };
+
+template <typename Axes>
+requires requires { typename Axes::value_type; }
+struct axis_handles<Axes>
+: std::bool_constant< AxisHandle<typename Axes::value_type> > { };
+
+template <typename... Axes>
+struct axis_handles<std::tuple<Axes...>>
+: std::bool_constant< (AxisHandle<Axes> && ...) > { };
+
+} // end namespace detail
+
+namespace detail {
+
+// hash consistent with json ==,
+// numbers of different types hash by their double value,
+// and -0.0 hashes as 0.0
+inline size_t json_hash(const nlohmann::json& j) {
+  using value_t = nlohmann::json::value_t;
+  const auto combine = [](size_t h, size_t x) {
+    return h ^ (x + 0x9E37'79B9'7F4A'7C15ull + (h << 6) + (h >> 2));
+  };
+  switch (j.type()) {
+    case value_t::null: return 0;
+    case value_t::boolean: return std::hash<bool>{}(j.get<bool>());
+    case value_t::number_integer:
+    case value_t::number_unsigned:
+    case value_t::number_float: {
+      const double x = j.get<double>();
+      return std::hash<double>{}(x == 0 ? 0. : x);
+    }
+    case value_t::string:
+      return std::hash<std::string>{}(j.get_ref<const std::string&>());
+    case value_t::array: {
+      size_t h = 1;
+      for (const auto& x : j) h = combine(h,json_hash(x));
+      return h;
+    }
+    case value_t::object: {
+      size_t h = 2;
+      for (const auto& [key, x] : j.items())
+        h = combine(combine(h,std::hash<std::string>{}(key)),json_hash(x));
+      return h;
+    }
+    default: return std::hash<nlohmann::json>{}(j);
+  }
+}
+
+// Index of the first element of defs equal to j.
+// j is appended if there is none.
+class json_index {
+  std::unordered_multimap<size_t,size_t> _map;
+
+public:
+  size_t operator()(nlohmann::json& defs, nlohmann::json&& j) {
+    const size_t h = json_hash(j);
+    size_t i = defs.size();
+    for (auto [it, end] = _map.equal_range(h); it != end; ++it)
+      if (it->second < i && defs[it->second] == j) i = it->second;
+    if (i == defs.size()) {
+      defs.push_back(std::move(j));
+      _map.emplace(h,i);
+    }
+    return i;
+  }
+};
+
+} // end namespace detail
+
+template <Histogram H>
+requires (!H::perbin_axes)
+void from_json(const nlohmann::json& j, H& h) {
+  detail::histogram_from_json(j,h,nullptr,nullptr);
+}
+
 template <typename T>
 concept HistogramDict = requires (T& hs) {
   {  std::get<0>(*hs.begin()) } -> convertible_to<std::string>;
   { *std::get<1>(*hs.begin()) } -> Histogram;
 };
 
-nlohmann::json to_json(const HistogramDict auto& hs) {
+namespace detail {
+
+template <bool Sparse>
+nlohmann::json histograms_to_json(const HistogramDict auto& hs) {
   using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
   using nlohmann::json;
   json axes  = json::array(),
        bins  = json::array(),
        hists = json::object();
+  // shared axes are de-duplicated by address, without comparing them
+  constexpr bool shared_axes = !hist_t::perbin_axes &&
+    detail::axis_handles<std::remove_cvref_t<typename hist_t::axes_type>>
+      ::value;
+  std::unordered_map<const void*,size_t> axis_index;
+  detail::json_index axis_ids, bin_ids;
   for (const auto& [name, h_ptr] : hs) {
-    auto& h = hists[name] = *h_ptr;
-    for (auto& a : h["axes"]) {
+    auto& h = hists[name];
+    if constexpr (shared_axes) {
+      auto& ha = h["axes"] = json::array();
+      cont::map([&](const auto& a) {
+        const auto [it, added] = axis_index.try_emplace(&*a, axes.size());
+        if (added) axes.push_back(*a);
+        ha.push_back(it->second);
+      }, h_ptr->axes());
+      auto& hb = h["bins"] = {
+        bin_def<typename hist_t::bin_type>::def(), nullptr };
+      if constexpr (Sparse) hb[1] = sparse_bins_json(*h_ptr);
+      else hb[1] = h_ptr->bins();
+    } else if constexpr (Sparse) h = as_sparse(*h_ptr);
+    else h = *h_ptr;
+    if constexpr (!shared_axes) for (auto& a : h["axes"]) {
       if constexpr (!hist_t::perbin_axes) {
-        unsigned i = 0, n = axes.size();
-        for (; i<n; ++i)
-          if (a == axes[i]) break;
-        if (i==n) axes.push_back(std::move(a));
-        a = i;
+        a = axis_ids(axes,std::move(a));
       } else {
-        for (auto& a : a) {
-          unsigned i = 0, n = axes.size();
-          for (; i<n; ++i)
-            if (a == axes[i]) break;
-          if (i==n) axes.push_back(std::move(a));
-          a = i;
-        }
+        for (auto& a : a)
+          a = axis_ids(axes,std::move(a));
       }
     }
     auto& hb = h["bins"][0];
-    if (!hb.is_null()) {
-      unsigned i = 0, n = bins.size();
-      for (; i<n; ++i)
-        if (hb == bins[i]) break;
-      if (i==n) bins.push_back(std::move(hb));
-      hb = i;
-    }
+    if (!hb.is_null())
+      hb = bin_ids(bins,std::move(hb));
   }
   return {
     { "axes" , std::move(axes ) },
@@ -76,12 +561,48 @@ nlohmann::json to_json(const HistogramDict auto& hs) {
   };
 }
 
+} // end namespace detail
+
+nlohmann::json to_json(const HistogramDict auto& hs) {
+  return detail::histograms_to_json<false>(hs);
+}
+
+template <HistogramDict Dict>
+void to_json(nlohmann::json& j, const sparse_ref<Dict>& s) {
+  j = detail::histograms_to_json<true>(s.x);
+}
+
+// Histograms missing from the dictionary are added if it holds
+// unique_ptr or shared_ptr, and are an error otherwise.
+template <HistogramDict Dict>
+void from_json(const nlohmann::json& j, Dict& hs) {
+  using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
+  const auto& axes = j.at("axes");
+  const auto& bins = j.at("bins");
+  for (const auto& [name, hj] : j.at("hists").items()) {
+    auto it = hs.find(name);
+    if (it == hs.end()) {
+      if constexpr (std::is_constructible_v<
+        typename Dict::mapped_type, std::unique_ptr<hist_t>
+      >) it = hs.emplace(name,std::make_unique<hist_t>()).first;
+      else throw std::invalid_argument(
+        "histogram json: no histogram \""+name+"\" in the dictionary");
+    }
+    detail::histogram_from_json(hj,*std::get<1>(*it),&axes,&bins);
+  }
+}
+
 #ifdef IVANP_HISTOGRAMS_BINS_HH
 
 void to_json(nlohmann::json& j, const ww2_bin<auto>& b) {
   j = { b.w, b.w2 };
 }
 template <typename T>
+void from_json(const nlohmann::json& j, ww2_bin<T>& b) {
+  b.w  = detail::json_number<T>(j.at(0));
+  b.w2 = detail::json_number<T>(j.at(1));
+}
+template <typename T>
 struct bin_def<ww2_bin<T>> {
   static nlohmann::json def() noexcept {
     return R"(["w","w2"])"_json;
@@ -92,18 +613,108 @@ void to_json(nlohmann::json& j, const mc_bin<auto,auto>& b) {
   j = { b.w, b.w2, b.n };
 }
 template <typename T, typename C>
+void from_json(const nlohmann::json& j, mc_bin<T,C>& b) {
+  b.w  = detail::json_number<T>(j.at(0));
+  b.w2 = detail::json_number<T>(j.at(1));
+  b.n  = j.at(2).get<C>();
+}
+template <typename T, typename C>
 struct bin_def<mc_bin<T,C>> {
   static nlohmann::json def() noexcept {
     return R"(["w","w2","n"])"_json;
   }
 };
 
+void to_json(nlohmann::json& j, const compensated_ww2_bin<auto>& b) {
+  j = { b.w.value(), b.w2.value() };
+}
+template <typename T>
+void from_json(const nlohmann::json& j, compensated_ww2_bin<T>& b) {
+  b.w  = { detail::json_number<T>(j.at(0)) };
+  b.w2 = { detail::json_number<T>(j.at(1)) };
+}
+template <typename T>
+struct bin_def<compensated_ww2_bin<T>>: bin_def<ww2_bin<T>> { };
+
+void to_json(nlohmann::json& j, const compensated_mc_bin<auto,auto>& b) {
+  j = { b.w.value(), b.w2.value(), b.n };
+}
+template <typename T, typename C>
+void from_json(const nlohmann::json& j, compensated_mc_bin<T,C>& b) {
+  b.w  = { detail::json_number<T>(j.at(0)) };
+  b.w2 = { detail::json_number<T>(j.at(1)) };
+  b.n  = j.at(2).get<C>();
+}
+template <typename T, typename C>
+struct bin_def<compensated_mc_bin<T,C>>: bin_def<mc_bin<T,C>> { };
+
+void to_json(nlohmann::json& j, const profile_bin<auto>& b) {
+  j = { b.w, b.w2, b.wy, b.wy2 };
+}
+template <typename T>
+void from_json(const nlohmann::json& j, profile_bin<T>& b) {
+  b.w   = detail::json_number<T>(j.at(0));
+  b.w2  = detail::json_number<T>(j.at(1));
+  b.wy  = detail::json_number<T>(j.at(2));
+  b.wy2 = detail::json_number<T>(j.at(3));
+}
+template <typename T>
+struct bin_def<profile_bin<T>> {
+  static nlohmann::json def() noexcept {
+    return R"(["w","w2","wy","wy2"])"_json;
+  }
+};
+
+template <unsigned C>
+void to_json(nlohmann::json& j, const tdigest_bin<C>& b) {
+  auto& c = (j = { b.min(), b.max(), nlohmann::json::array() })[2];
+  for (const auto& x : b.centroids())
+    c.push_back({ x.mean, x.w });
+}
+template <unsigned C>
+struct bin_def<tdigest_bin<C>> {
+  static nlohmann::json def() noexcept {
+    return R"(["min","max",["mean","w"]])"_json;
+  }
+};
+
 void to_json(nlohmann::json& j, const nlo_mc_multibin& b) {
   j = { b.ww2, b.n, b.nent };
 }
 
 #endif
 
+#ifdef IVANP_HISTOGRAMS_AXIS_REGISTRY_HH
+
+template <typename Axis>
+void to_json(nlohmann::json& j, const axis_ref<Axis>& axis) {
+  j = *axis;
+}
+
+// equal axes read from json share one interned axis
+template <typename Axis>
+void from_json(const nlohmann::json& j, axis_ref<Axis>& axis) {
+  axis = intern_axis(j.get<Axis>());
+}
+
+#endif
+
+#ifdef IVANP_HISTOGRAMS_STORAGE_HH
+
+template <typename H, typename M, index_type K>
+void to_json(nlohmann::json& j, const promoted_bins<H,M,K>& bins) {
+  j = nlohmann::json::array();
+  for (const auto& b : bins) j.push_back(b);
+}
+
+template <typename Bin, unsigned B>
+void to_json(nlohmann::json& j, const chunked_bins<Bin,B>& bins) {
+  j = nlohmann::json::array();
+  for (const auto& b : bins) j.push_back(b);
+}
+
+#endif
+
 } // end namespace ivanp::hist
 
 namespace nlohmann {
@@ -113,6 +724,9 @@ struct adl_serializer<T> {
   static void to_json(json& j, const T& hs) {
     j = ivanp::hist::to_json(hs);
   }
+  static void from_json(const json& j, T& hs) {
+    ivanp::hist::from_json(j,hs);
+  }
 };
 
 } // end namespace nlohmann
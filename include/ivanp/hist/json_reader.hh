@@ -0,0 +1,389 @@
+#ifndef IVANP_HISTOGRAMS_JSON_READER_HH
+#define IVANP_HISTOGRAMS_JSON_READER_HH
+
+#ifndef IVANP_HISTOGRAMS_HH
+#error "must include histograms.hh first"
+#else
+
+#include <cstring>
+#include <cmath>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <iterator>
+
+#include <ivanp/hist/json.hh>
+
+// Reads the format of json.hh from text, without building a
+// nlohmann::json document for the bins, which are decoded directly
+// into the histogram storage with std::from_chars.
+// Axis and bin definitions are small, and are read with from_json().
+// Types without a read_json() overload are read with from_json().
+
+namespace ivanp::hist {
+
+// Cursor over JSON text ============================================
+class json_cursor {
+  const char *_begin, *_p, *_end;
+
+public:
+  explicit json_cursor(std::string_view s) noexcept
+  : _begin(s.data()), _p(s.data()), _end(s.data()+s.size()) { }
+
+  [[noreturn]] void error(const char* what) const {
+    throw std::invalid_argument(
+      std::string("histogram json: ") + what
+      + " at offset " + std::to_string(_p-_begin) );
+  }
+
+  const char* pos() const noexcept { return _p; }
+  const char* end() const noexcept { return _end; }
+  void seek(const char* p) noexcept { _p = p; }
+
+  void ws() noexcept {
+    while (_p != _end && (*_p==' ' || *_p=='\n' || *_p=='\r' || *_p=='\t'))
+      ++_p;
+  }
+  char peek() noexcept {
+    ws();
+    return _p != _end ? *_p : '\0';
+  }
+  bool consume(char c) noexcept {
+    if (peek() != c) return false;
+    ++_p;
+    return true;
+  }
+  void expect(char c) {
+    if (!consume(c)) {
+      const char what[] = { 'e','x','p','e','c','t','e','d',' ','\'',c,'\'',0 };
+      error(what);
+    }
+  }
+  // after '[' or '{', true if there is another element
+  bool next(bool first, char close) {
+    if (consume(close)) return false;
+    if (!first) expect(',');
+    return true;
+  }
+
+  std::string string() {
+    expect('"');
+    const char* const b = _p - 1;
+    std::string s;
+    for (;;) {
+      const char* q = _p;
+      while (q != _end && *q != '"' && *q != '\\') ++q;
+      s.append(_p,q);
+      _p = q;
+      if (_p == _end) error("unterminated string");
+      if (*_p++ == '"') return s;
+      if (_p == _end) error("unterminated string");
+      switch (const char c = *_p++) {
+        case 'b': s += '\b'; break;
+        case 'f': s += '\f'; break;
+        case 'n': s += '\n'; break;
+        case 'r': s += '\r'; break;
+        case 't': s += '\t'; break;
+        case 'u': // unicode escapes are left to nlohmann::json
+          _p = b;
+          skip_string();
+          return nlohmann::json::parse(b,_p).get<std::string>();
+        default: s += c;
+      }
+    }
+  }
+
+  template <typename T>
+  T number() {
+    ws();
+    if constexpr (std::is_floating_point_v<T>) {
+      // nonfinite numbers are written as null
+      if (_end-_p >= 4 && std::memcmp(_p,"null",4)==0) {
+        _p += 4;
+        return std::numeric_limits<T>::quiet_NaN();
+      }
+    }
+    T x;
+    auto r = std::from_chars(_p,_end,x);
+    if constexpr (std::is_integral_v<T>) {
+      // integer written as a floating point number
+      if (r.ec == std::errc{} && r.ptr != _end && std::strchr(".eE",*r.ptr)) {
+        double d;
+        r = std::from_chars(_p,_end,d);
+        x = T(d);
+      }
+    }
+    if (r.ec != std::errc{}) error("expected number");
+    _p = r.ptr;
+    return x;
+  }
+
+  // skips a value, returning its text
+  std::string_view value() {
+    ws();
+    const char* const b = _p;
+    int depth = 0;
+    do {
+      if (_p == _end) error("unexpected end of input");
+      switch (*_p) {
+        case '"': skip_string(); continue;
+        case '[': case '{': ++depth; break;
+        case ']': case '}': --depth; break;
+        default:
+          if (depth == 0) { // scalar
+            while (_p != _end && !std::strchr(",]} \n\r\t",*_p)) ++_p;
+            return { b, size_t(_p-b) };
+          }
+          // numbers, literals and separators up to the next bracket
+          while (++_p != _end && !structural(*_p)) ;
+          continue;
+      }
+      ++_p;
+    } while (depth > 0);
+    return { b, size_t(_p-b) };
+  }
+
+  nlohmann::json dom() {
+    const auto s = value();
+    return nlohmann::json::parse(s.begin(),s.end());
+  }
+
+private:
+  static bool structural(char c) noexcept {
+    return c=='"' || c=='[' || c==']' || c=='{' || c=='}';
+  }
+
+  void skip_string() {
+    for (++_p; ; ++_p) {
+      const char* q = static_cast<const char*>(
+        std::memchr(_p,'"',_end-_p) );
+      if (!q) { _p = _end; error("unterminated string"); }
+      // count preceding backslashes
+      const char* r = q;
+      while (r != _p && r[-1] == '\\') --r;
+      _p = q;
+      if ((q-r) % 2 == 0) { ++_p; return; }
+    }
+  }
+};
+
+// Values ===========================================================
+
+template <typename T>
+void read_json(json_cursor& c, T& x) {
+  if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T,bool>)
+    x = c.template number<T>();
+  else
+    c.dom().get_to(x);
+}
+
+#ifdef IVANP_HISTOGRAMS_BINS_HH
+
+template <typename T>
+void read_json(json_cursor& c, ww2_bin<T>& b) {
+  c.expect('[');
+  b.w  = c.template number<T>(); c.expect(',');
+  b.w2 = c.template number<T>(); c.expect(']');
+}
+
+template <typename T, typename C>
+void read_json(json_cursor& c, mc_bin<T,C>& b) {
+  c.expect('[');
+  b.w  = c.template number<T>(); c.expect(',');
+  b.w2 = c.template number<T>(); c.expect(',');
+  b.n  = c.template number<C>(); c.expect(']');
+}
+
+template <typename T>
+void read_json(json_cursor& c, compensated_ww2_bin<T>& b) {
+  c.expect('[');
+  b.w  = { c.template number<T>() }; c.expect(',');
+  b.w2 = { c.template number<T>() }; c.expect(']');
+}
+
+template <typename T, typename C>
+void read_json(json_cursor& c, compensated_mc_bin<T,C>& b) {
+  c.expect('[');
+  b.w  = { c.template number<T>() }; c.expect(',');
+  b.w2 = { c.template number<T>() }; c.expect(',');
+  b.n  = c.template number<C>(); c.expect(']');
+}
+
+template <typename T>
+void read_json(json_cursor& c, profile_bin<T>& b) {
+  c.expect('[');
+  b.w   = c.template number<T>(); c.expect(',');
+  b.w2  = c.template number<T>(); c.expect(',');
+  b.wy  = c.template number<T>(); c.expect(',');
+  b.wy2 = c.template number<T>(); c.expect(']');
+}
+
+#endif
+
+// Histograms =======================================================
+
+namespace detail {
+
+// bins of h from "bins": [ def, [ . . . ] ], the sparse form
+// "bins": [ def, { . . . } ], or the abbreviated "bins": def
+template <Histogram H>
+void read_bins(json_cursor& c, H& h, const nlohmann::json* bins) {
+  using bin_type = typename H::bin_type;
+  const char* const start = c.pos();
+  if (c.consume('[') && c.peek() != '"' && c.peek() != ']') {
+    const auto def = c.dom();
+    if (c.consume(',')) {
+      const size_t n = h.nbins();
+      if (c.consume('[')) {
+        check_bin_def<bin_type>(def,bins);
+        size_t i = 0;
+        for (bool first = true; c.next(first,']'); first = false) {
+          if (i == n) c.error("number of bins does not match the axes");
+          read_json(c,load_bin(h,i++));
+        }
+        if (i != n) c.error("number of bins does not match the axes");
+        c.expect(']');
+        return;
+      }
+      if (c.consume('{')) { // sparse, the other bins stay empty
+        check_bin_def<bin_type>(def,bins);
+        for (bool first = true; c.next(first,'}'); first = false) {
+          const auto key = c.string();
+          c.expect(':');
+          if (key == "size") {
+            if (c.number<size_t>() != n)
+              c.error("number of bins does not match the axes");
+          } else if (key == "runs") {
+            c.expect('[');
+            for (bool first = true; c.next(first,']'); first = false) {
+              c.expect('[');
+              size_t i = c.number<size_t>();
+              if (i > n) c.error("sparse bins past the last bin");
+              c.expect(',');
+              c.expect('[');
+              for (bool first = true; c.next(first,']'); first = false) {
+                if (i == n) c.error("sparse bins past the last bin");
+                read_json(c,load_bin(h,i++));
+              }
+              c.expect(']');
+            }
+          } else c.value();
+        }
+        c.expect(']');
+        return;
+      }
+    }
+  }
+  c.seek(start);
+  check_bin_def<bin_type>(c.dom(),bins);
+}
+
+// histogram object, with definitions that may refer to the global arrays
+template <Histogram H>
+void read_histogram(
+  json_cursor& c, H& h,
+  const nlohmann::json* axes, const nlohmann::json* bins
+) {
+  c.expect('{');
+  const char* bins_pos = nullptr;
+  bool has_axes = false;
+  for (bool first = true; c.next(first,'}'); first = false) {
+    const auto key = c.string();
+    c.expect(':');
+    if (key == "axes") {
+      h = H(axes_from_json<std::remove_cvref_t<typename H::axes_type>>(
+        c.dom(), axes ));
+      has_axes = true;
+    } else if (key == "bins" && has_axes) {
+      read_bins(c,h,bins);
+    } else {
+      if (key == "bins") bins_pos = c.pos(); // before "axes"
+      c.value();
+    }
+  }
+  if (!has_axes) c.error("histogram without axes");
+  if (bins_pos) {
+    const char* const end = c.pos();
+    c.seek(bins_pos);
+    read_bins(c,h,bins);
+    c.seek(end);
+  }
+}
+
+template <HistogramDict Dict>
+void read_hists(
+  json_cursor& c, Dict& hs,
+  const nlohmann::json* axes, const nlohmann::json* bins
+) {
+  using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
+  c.expect('{');
+  for (bool first = true; c.next(first,'}'); first = false) {
+    const auto name = c.string();
+    c.expect(':');
+    auto it = hs.find(name);
+    if (it == hs.end()) {
+      if constexpr (std::is_constructible_v<
+        typename Dict::mapped_type, std::unique_ptr<hist_t>
+      >) it = hs.emplace(name,std::make_unique<hist_t>()).first;
+      else c.error(("no histogram \""+name+"\" in the dictionary").c_str());
+    }
+    read_histogram(c,*std::get<1>(*it),axes,bins);
+  }
+}
+
+} // end namespace detail
+
+template <Histogram H>
+requires (!H::perbin_axes)
+void read_json(json_cursor& c, H& h) {
+  detail::read_histogram(c,h,nullptr,nullptr);
+}
+
+// Same as from_json() for a dictionary.
+// The global "axes" and "bins" are read first, wherever they are.
+template <HistogramDict Dict>
+void read_json(json_cursor& c, Dict& hs) {
+  nlohmann::json axes, bins;
+  const char* hists_pos = nullptr;
+  c.expect('{');
+  for (bool first = true; c.next(first,'}'); first = false) {
+    const auto key = c.string();
+    c.expect(':');
+    if (key == "axes") axes = c.dom();
+    else if (key == "bins") bins = c.dom();
+    else if (key == "hists") {
+      if (!axes.is_null() && !bins.is_null())
+        detail::read_hists(c,hs,&axes,&bins);
+      else { // before the definitions
+        hists_pos = c.pos();
+        c.value();
+      }
+    } else c.value();
+  }
+  if (hists_pos) {
+    const char* const end = c.pos();
+    c.seek(hists_pos);
+    detail::read_hists(c,hs,&axes,&bins);
+    c.seek(end);
+  }
+}
+
+template <typename T>
+void read_json(std::string_view text, T& x) {
+  json_cursor c(text);
+  read_json(c,x);
+  if (c.peek() != '\0') c.error("unexpected text after the end");
+}
+
+template <typename T>
+void read_json(std::istream& in, T& x) {
+  const std::string text(
+    std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>{} );
+  read_json(std::string_view(text),x);
+}
+
+} // end namespace ivanp::hist
+
+#endif
+#endif
@@ -0,0 +1,683 @@
+#ifndef IVANP_HISTOGRAMS_JSON_WRITER_HH
+#define IVANP_HISTOGRAMS_JSON_WRITER_HH
+
+#ifndef IVANP_HISTOGRAMS_HH
+#error "must include histograms.hh first"
+#else
+
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <system_error>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+
+#include <ivanp/hist/json.hh>
+#include <ivanp/hist/parallel.hh>
+
+// Writes the format of json.hh directly to a file descriptor, a stream,
+// or a string, without building a nlohmann::json document.
+// Numbers are laid out like nlohmann::json::dump(),
+// but with the shortest round trip digits from std::to_chars,
+// where dump() prints an extra digit for some doubles.
+// Types without a write_json() overload are converted with to_json().
+
+namespace ivanp::hist {
+
+namespace detail {
+
+// JSON number in the format of nlohmann::json::dump()
+inline char* format_json_double(char* p, double x) noexcept {
+  if (!std::isfinite(x)) {
+    std::memcpy(p,"null",4);
+    return p+4;
+  }
+  if (std::signbit(x)) {
+    *p++ = '-';
+    x = -x;
+  }
+  if (x == 0) {
+    std::memcpy(p,"0.0",3);
+    return p+3;
+  }
+  // shortest digits and decimal exponent, d.ddde±xx
+  char s[32];
+  const char* const s_end =
+    std::to_chars(s,s+sizeof(s),x,std::chars_format::scientific).ptr;
+  char d[24];
+  int k = 0;
+  const char* q = s;
+  for (; *q != 'e'; ++q)
+    if (*q != '.') d[k++] = *q;
+  const bool neg_exp = *++q == '-';
+  int e = 0;
+  std::from_chars(q+1,s_end,e);
+  const int n = (neg_exp ? -e : e) + 1; // position of the decimal point
+
+  if (k <= n && n <= 15) { // ddd000.0
+    std::memcpy(p,d,k);
+    p += k;
+    std::memset(p,'0',n-k);
+    p += n-k;
+    std::memcpy(p,".0",2);
+    return p+2;
+  }
+  if (0 < n && n <= 15) { // ddd.ddd
+    std::memcpy(p,d,n);
+    p += n;
+    *p++ = '.';
+    std::memcpy(p,d+n,k-n);
+    return p+(k-n);
+  }
+  if (-4 < n && n <= 0) { // 0.000ddd
+    std::memcpy(p,"0.",2);
+    p += 2;
+    std::memset(p,'0',-n);
+    p += -n;
+    std::memcpy(p,d,k);
+    return p+k;
+  }
+  // d.ddde±xx
+  *p++ = d[0];
+  if (k > 1) {
+    *p++ = '.';
+    std::memcpy(p,d+1,k-1);
+    p += k-1;
+  }
+  *p++ = 'e';
+  int m = n-1;
+  if (m < 0) {
+    *p++ = '-';
+    m = -m;
+  } else *p++ = '+';
+  if (m < 10) *p++ = '0';
+  return std::to_chars(p,p+3,m).ptr;
+}
+
+} // end namespace detail
+
+// Buffered output ==================================================
+class json_writer {
+  std::unique_ptr<char[]> _buf;
+  size_t _cap, _len = 0;
+  int _fd = -1;
+  std::ostream* _os = nullptr;
+  std::string* _str = nullptr;
+
+  void sink(const char* s, size_t n) {
+    if (_fd >= 0) {
+      while (n) {
+        const ssize_t w = ::write(_fd,s,n);
+        if (w < 0) {
+          if (errno == EINTR) continue;
+          throw std::system_error(errno,std::generic_category(),
+            "json_writer: write");
+        }
+        s += w;
+        n -= w;
+      }
+    } else if (_os) {
+      if (!_os->write(s,n)) throw std::runtime_error(
+        "json_writer: stream write failed");
+    } else {
+      _str->append(s,n);
+    }
+  }
+
+  // space for n more characters, n must not exceed the buffer size
+  char* reserve(size_t n) {
+    if (_cap - _len < n) flush();
+    return _buf.get() + _len;
+  }
+  void commit(char* end) noexcept { _len = end - _buf.get(); }
+
+  explicit json_writer(size_t buffer_size)
+  : _cap(std::max<size_t>(buffer_size,64)) // fits any number
+  { _buf.reset(new char[_cap]); }
+
+public:
+  static constexpr size_t default_buffer_size = 1 << 16;
+
+  explicit json_writer(int fd, size_t buffer_size = default_buffer_size)
+  : json_writer(buffer_size) { _fd = fd; }
+  explicit json_writer(
+    std::ostream& os, size_t buffer_size = default_buffer_size
+  ): json_writer(buffer_size) { _os = &os; }
+  explicit json_writer(
+    std::string& str, size_t buffer_size = default_buffer_size
+  ): json_writer(buffer_size) { _str = &str; }
+
+  json_writer(const json_writer&) = delete;
+  json_writer& operator=(const json_writer&) = delete;
+
+  // call flush() to see write errors, they are ignored here
+  ~json_writer() {
+    try { flush(); } catch (...) { }
+  }
+
+  void flush() {
+    if (_len) {
+      const size_t n = _len;
+      _len = 0;
+      sink(_buf.get(),n);
+    }
+  }
+
+  json_writer& put(char c) {
+    *reserve(1) = c;
+    ++_len;
+    return *this;
+  }
+
+  // unescaped text
+  json_writer& raw(std::string_view s) {
+    if (s.size() > _cap) {
+      flush();
+      sink(s.data(),s.size());
+    } else {
+      std::memcpy(reserve(s.size()),s.data(),s.size());
+      _len += s.size();
+    }
+    return *this;
+  }
+
+  json_writer& null() { return raw("null"); }
+  json_writer& boolean(bool x) { return raw(x ? "true" : "false"); }
+
+  template <typename T>
+  requires std::is_integral_v<T>
+  json_writer& number(T x) {
+    char* p = reserve(24);
+    commit(std::to_chars(p,p+24,x).ptr);
+    return *this;
+  }
+  json_writer& number(double x) {
+    commit(detail::format_json_double(reserve(32),x));
+    return *this;
+  }
+
+  json_writer& string(std::string_view s) {
+    put('"');
+    for (const char c : s) {
+      char* p = reserve(6);
+      switch (c) {
+        case '"' : std::memcpy(p,"\\\"",2); p += 2; break;
+        case '\\': std::memcpy(p,"\\\\",2); p += 2; break;
+        case '\b': std::memcpy(p,"\\b" ,2); p += 2; break;
+        case '\f': std::memcpy(p,"\\f" ,2); p += 2; break;
+        case '\n': std::memcpy(p,"\\n" ,2); p += 2; break;
+        case '\r': std::memcpy(p,"\\r" ,2); p += 2; break;
+        case '\t': std::memcpy(p,"\\t" ,2); p += 2; break;
+        default:
+          if ((unsigned char)c < 0x20) {
+            constexpr char hex[] = "0123456789abcdef";
+            std::memcpy(p,"\\u00",4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xF];
+            p += 6;
+          } else *p++ = c;
+      }
+      commit(p);
+    }
+    return put('"');
+  }
+
+  json_writer& key(std::string_view s) { return string(s).put(':'); }
+};
+
+// Values ===========================================================
+
+template <typename... T>
+void write_json_array(json_writer& w, const T&... xs);
+
+template <typename T>
+void write_json(json_writer& w, const T& x) {
+  if constexpr (std::is_same_v<T,bool>)
+    w.boolean(x);
+  else if constexpr (std::is_integral_v<T>)
+    w.number(x);
+  else if constexpr (std::is_floating_point_v<T>)
+    w.number(double(x));
+  else if constexpr (std::is_same_v<T,std::nullptr_t>)
+    w.null();
+  else if constexpr (std::is_convertible_v<const T&,std::string_view>)
+    w.string(x);
+  else if constexpr (cont::Tuple<T>) {
+    std::apply([&](const auto&... xs){ write_json_array(w,xs...); }, x);
+  } else if constexpr (cont::List<T>) {
+    w.put('[');
+    bool first = true;
+    for (const auto& e : x) {
+      if (first) first = false;
+      else w.put(',');
+      write_json(w,e);
+    }
+    w.put(']');
+  } else {
+    w.raw(nlohmann::json(x).dump());
+  }
+}
+
+template <typename... T>
+void write_json_array(json_writer& w, const T&... xs) {
+  w.put('[');
+  bool first = true;
+  ((first ? void(first = false) : void(w.put(',')), write_json(w,xs)), ...);
+  w.put(']');
+}
+
+// Axes =============================================================
+
+template <typename Cont, typename Edge>
+void write_json(json_writer& w, const cont_axis<Cont,Edge>& axis) {
+  write_json(w,axis.edges());
+}
+
+template <typename Edge>
+void write_json(json_writer& w, const log_uniform_axis<Edge>& axis) {
+  w.put('[');
+  write_json_array(w, axis.min(), axis.max(), axis.ndiv(), "log");
+  w.put(']');
+}
+
+template <typename Transform, typename Edge>
+void write_json(
+  json_writer& w, const transformed_axis<Transform,Edge>& axis
+) {
+  w.put('[');
+  write_json_array(w, axis.min(), axis.max(), axis.ndiv(), Transform::name);
+  w.put(']');
+}
+
+template <typename Int>
+void write_json(json_writer& w, const integer_axis<Int>& axis) {
+  w.put('[');
+  write_json_array(w, axis.min(), axis.max(), axis.ndiv());
+  w.put(']');
+}
+
+template <typename Edge>
+void write_json(json_writer& w, const uniform_axis<Edge>& axis) {
+  w.put('[');
+  write_json_array(w, axis.min(), axis.max(), axis.ndiv());
+  w.put(']');
+}
+
+template <typename Edge>
+void write_json(json_writer& w, const growable_uniform_axis<Edge>& axis) {
+  w.put('[');
+  write_json_array(w, axis.min(), axis.max(), axis.ndiv());
+  w.put(']');
+}
+
+template <typename Label, bool Growable>
+void write_json(
+  json_writer& w, const category_axis<Label,Growable>& axis
+) {
+  w.put('{').key("categories").put('[');
+  bool first = true;
+  for (const auto& label : axis.labels()) {
+    if (first) first = false;
+    else w.put(',');
+    write_json(w,label);
+  }
+  // unused bins reserved by a growable axis
+  for (index_type i=axis.nlabels(), n=axis.ndiv(); i<n; ++i) {
+    if (first) first = false;
+    else w.put(',');
+    w.null();
+  }
+  w.put(']').put('}');
+}
+
+template <typename Axis>
+void write_json(json_writer& w, const noflow_axis<Axis>& axis) {
+  w.put('{').key("axis");
+  write_json(w,axis.axis());
+  w.put(',').key("flow").boolean(false).put('}');
+}
+
+template <typename Axis>
+void write_json(json_writer& w, const hinted_axis<Axis>& axis) {
+  write_json(w,axis.axis());
+}
+
+template <typename... Axes>
+void write_json(json_writer& w, const variant_axis<Axes...>& axis) {
+  std::visit([&w](const auto& a){ write_json(w,a); }, *axis);
+}
+
+// Histograms =======================================================
+
+template <Histogram H>
+void write_json(json_writer& w, const H& h) {
+  w.put('{').key("axes");
+  write_json(w,h.axes());
+  w.put(',').key("bins").put('[');
+  w.raw(bin_def<typename H::bin_type>::def().dump()).put(',');
+  write_json(w,h.bins());
+  w.put(']').put('}');
+}
+
+namespace detail {
+
+template <Histogram H>
+void write_sparse_bins(json_writer& w, const H& h) {
+  w.put('{').key("runs").put('[');
+  bool first_run = true;
+  sparse_runs(h,[&](size_t i, auto first, auto last) {
+    if (first_run) first_run = false;
+    else w.put(',');
+    w.put('[').number(i).put(',').put('[');
+    for (auto it = first; it != last; ++it) {
+      if (it != first) w.put(',');
+      write_json(w,*it);
+    }
+    w.put(']').put(']');
+  });
+  w.put(']').put(',').key("size").number(size_t(h.nbins()));
+  w.put('}');
+}
+
+} // end namespace detail
+
+template <Histogram H>
+void write_json(json_writer& w, const sparse_ref<H>& s) {
+  w.put('{').key("axes");
+  write_json(w,s.x.axes());
+  w.put(',').key("bins").put('[');
+  w.raw(bin_def<typename H::bin_type>::def().dump()).put(',');
+  detail::write_sparse_bins(w,s.x);
+  w.put(']').put('}');
+}
+
+namespace detail {
+
+// Writes texts in the order of their indices, from any thread.
+// The thread that adds the next text in line also writes those
+// that are ready after it. Other threads wait while the queued texts
+// would exceed max_queued bytes, unless nothing is queued, so at most
+// max_queued bytes plus one text per thread are held in memory.
+// Indices must be taken in increasing order, as by parallel_for(),
+// so that the thread with the next text is never waiting.
+class ordered_writer {
+  json_writer& w;
+  std::mutex m;
+  std::condition_variable cv;
+  std::map<size_t,std::string> ready;
+  size_t queued = 0, max_queued;
+  size_t next = 0;
+  bool busy = false, failed = false;
+
+public:
+  ordered_writer(json_writer& w, size_t max_queued)
+  : w(w), max_queued(max_queued) { }
+
+  void write(size_t k, std::string text) {
+    std::unique_lock lock(m);
+    cv.wait(lock,[&]{
+      return failed || k == next || queued == 0
+          || queued + text.size() <= max_queued;
+    });
+    if (failed) return;
+    queued += text.size();
+    ready.emplace(k,std::move(text));
+    if (busy) return;
+    busy = true;
+    for (auto it = ready.begin();
+      it != ready.end() && it->first == next;
+      it = ready.begin()
+    ) {
+      const std::string s = std::move(it->second);
+      ready.erase(it);
+      queued -= s.size();
+      ++next;
+      lock.unlock();
+      cv.notify_all();
+      try {
+        w.raw(s);
+      } catch (...) {
+        fail();
+        throw;
+      }
+      lock.lock();
+    }
+    busy = false;
+  }
+  // wakes the waiting threads, which drop their texts
+  void fail() {
+    { std::lock_guard lock(m); failed = true; }
+    cv.notify_all();
+  }
+};
+
+// The document of to_json(hs), with histograms in iteration order.
+// For an ordered dictionary, the text is that of to_json(hs).dump(),
+// unless a double is printed with different digits.
+// Axes are serialized to strings and de-duplicated by comparing them,
+// so unlike in to_json(), equal axes with NaN edges share an entry.
+// With more than one thread, the histograms are written to separate
+// buffers in parallel, which are then written in order,
+// holding back about max_queued bytes at most.
+template <bool Sparse>
+void write_histograms(
+  json_writer& w, const HistogramDict auto& hs,
+  unsigned threads = 1, size_t max_queued = 0
+) {
+  using hist_t = std::decay_t<decltype(*std::get<1>(*hs.begin()))>;
+  constexpr bool shared_axes = !hist_t::perbin_axes &&
+    detail::axis_handles<std::remove_cvref_t<typename hist_t::axes_type>>
+      ::value;
+
+  std::vector<const std::string*> axes;
+  std::unordered_map<std::string,size_t> axis_index;
+  std::unordered_map<const void*,size_t> axis_addr;
+  std::string buf;
+  const auto add_axis = [&](const auto& a) -> size_t {
+    buf.clear();
+    { json_writer bw(buf);
+      write_json(bw,a);
+    }
+    const auto [it, added] = axis_index.try_emplace(buf, axes.size());
+    if (added) axes.push_back(&it->first);
+    return it->second;
+  };
+
+  // first pass: collect the axes
+  std::vector<size_t> ii; // axis indices of all histograms
+  std::vector<size_t> ii_begin; // first axis index of every histogram
+  for (const auto& [name, h_ptr] : hs) {
+    ii_begin.push_back(ii.size());
+    if constexpr (shared_axes) {
+      cont::map([&](const auto& a) {
+        const auto [it, added] = axis_addr.try_emplace(&*a, axes.size());
+        if (added) {
+          buf.clear();
+          { json_writer bw(buf);
+            write_json(bw,*a);
+          }
+          axes.push_back(&axis_index.try_emplace(buf, it->second)
+            .first->first);
+        }
+        ii.push_back(it->second);
+      }, h_ptr->axes());
+    } else if constexpr (!hist_t::perbin_axes) {
+      cont::map([&](const auto& a) {
+        ii.push_back(add_axis(a));
+      }, h_ptr->axes());
+    } else {
+      cont::map([&](const auto& dim) {
+        for (const auto& a : dim)
+          ii.push_back(add_axis(a));
+      }, h_ptr->axes());
+    }
+  }
+  // all histograms have the same bin type
+  const auto def = bin_def<typename hist_t::bin_type>::def();
+  const bool bins_def = !def.is_null() && hs.begin() != hs.end();
+
+  // second pass: write definitions and stream the bins
+  w.put('{').key("axes").put('[');
+  for (size_t i=0; i<axes.size(); ++i) {
+    if (i) w.put(',');
+    w.raw(*axes[i]);
+  }
+  w.put(']').put(',').key("bins").put('[');
+  if (bins_def) w.raw(def.dump());
+  w.put(']').put(',').key("hists").put('{');
+  const auto write_hist = [&](
+    json_writer& w, const auto& name, const auto& h_ptr, size_t ai
+  ) {
+    w.key(name).put('{').key("axes").put('[');
+    if constexpr (!hist_t::perbin_axes) {
+      for (size_t d=0, n=h_ptr->ndim(); d<n; ++d) {
+        if (d) w.put(',');
+        w.number(ii[ai++]);
+      }
+    } else {
+      bool first = true;
+      cont::map([&](const auto& dim) {
+        if (first) first = false;
+        else w.put(',');
+        w.put('[');
+        for (size_t d=0, n=std::size(dim); d<n; ++d) {
+          if (d) w.put(',');
+          w.number(ii[ai++]);
+        }
+        w.put(']');
+      }, h_ptr->axes());
+    }
+    w.put(']').put(',').key("bins").put('[');
+    if (bins_def) w.number(0);
+    else w.null();
+    w.put(',');
+    if constexpr (Sparse) write_sparse_bins(w,*h_ptr);
+    else write_json(w,h_ptr->bins());
+    w.put(']').put('}');
+  };
+  if (threads == 1) {
+    size_t k = 0;
+    for (const auto& [name, h_ptr] : hs) {
+      if (k) w.put(',');
+      write_hist(w,name,h_ptr,ii_begin[k++]);
+    }
+  } else {
+    std::vector<const std::decay_t<decltype(*hs.begin())>*> items;
+    items.reserve(ii_begin.size());
+    for (const auto& item : hs) items.push_back(&item);
+    ordered_writer out(w,max_queued);
+    parallel_for(items.size(),threads,[&](size_t k){
+      std::string buf;
+      try {
+        json_writer bw(buf);
+        if (k) bw.put(',');
+        const auto& [name, h_ptr] = *items[k];
+        write_hist(bw,name,h_ptr,ii_begin[k]);
+      } catch (...) {
+        out.fail();
+        throw;
+      }
+      out.write(k,std::move(buf));
+    });
+  }
+  w.put('}').put('}');
+}
+
+} // end namespace detail
+
+void write_json(json_writer& w, const HistogramDict auto& hs) {
+  detail::write_histograms<false>(w,hs);
+}
+
+template <HistogramDict Dict>
+void write_json(json_writer& w, const sparse_ref<Dict>& s) {
+  detail::write_histograms<true>(w,s.x);
+}
+
+// Same output as write_json(), with the histograms written
+// by the given number of threads, or by all cores if 0.
+// Texts of histograms that are done before those preceding them
+// are held in memory, up to about max_queued bytes.
+void write_json_parallel(
+  json_writer& w, const HistogramDict auto& hs,
+  unsigned threads = 0, size_t max_queued = size_t(1) << 26
+) {
+  detail::write_histograms<false>(w,hs,threads,max_queued);
+}
+
+template <HistogramDict Dict>
+void write_json_parallel(
+  json_writer& w, const sparse_ref<Dict>& s,
+  unsigned threads = 0, size_t max_queued = size_t(1) << 26
+) {
+  detail::write_histograms<true>(w,s.x,threads,max_queued);
+}
+
+#ifdef IVANP_HISTOGRAMS_BINS_HH
+
+template <typename T>
+void write_json(json_writer& w, const ww2_bin<T>& b) {
+  write_json_array(w, b.w, b.w2);
+}
+
+template <typename T, typename C>
+void write_json(json_writer& w, const mc_bin<T,C>& b) {
+  write_json_array(w, b.w, b.w2, b.n);
+}
+
+template <typename T>
+void write_json(json_writer& w, const compensated_ww2_bin<T>& b) {
+  write_json_array(w, b.w.value(), b.w2.value());
+}
+
+template <typename T, typename C>
+void write_json(json_writer& w, const compensated_mc_bin<T,C>& b) {
+  write_json_array(w, b.w.value(), b.w2.value(), b.n);
+}
+
+template <typename T>
+void write_json(json_writer& w, const profile_bin<T>& b) {
+  write_json_array(w, b.w, b.w2, b.wy, b.wy2);
+}
+
+template <unsigned C>
+void write_json(json_writer& w, const tdigest_bin<C>& b) {
+  w.put('[');
+  write_json(w,b.min());
+  w.put(',');
+  write_json(w,b.max());
+  w.put(',').put('[');
+  bool first = true;
+  for (const auto& x : b.centroids()) {
+    if (first) first = false;
+    else w.put(',');
+    write_json_array(w, x.mean, x.w);
+  }
+  w.put(']').put(']');
+}
+
+#endif
+
+#ifdef IVANP_HISTOGRAMS_AXIS_REGISTRY_HH
+
+template <typename Axis>
+void write_json(json_writer& w, const axis_ref<Axis>& axis) {
+  write_json(w,*axis);
+}
+
+#endif
+
+} // end namespace ivanp::hist
+
+#endif
+#endif
@@ -0,0 +1,66 @@
+#ifndef IVANP_HISTOGRAMS_MAPPED_FILE_HH
+#define IVANP_HISTOGRAMS_MAPPED_FILE_HH
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ivanp::hist::detail {
+
+// read-only file mapping
+class mapped_file {
+  const char* _data = nullptr;
+  size_t _size = 0;
+
+public:
+  mapped_file() noexcept = default;
+  explicit mapped_file(const std::string& path) {
+    const int fd = ::open(path.c_str(),O_RDONLY);
+    if (fd < 0) throw std::system_error(errno,std::generic_category(),
+      "cannot open "+path);
+    struct stat st;
+    if (::fstat(fd,&st) < 0) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err,std::generic_category(),
+        "cannot stat "+path);
+    }
+    _size = st.st_size;
+    if (_size == 0) { // mmap() fails on empty files
+      ::close(fd);
+      return;
+    }
+    void* const m = ::mmap(nullptr,_size,PROT_READ,MAP_PRIVATE,fd,0);
+    const int err = errno;
+    ::close(fd);
+    if (m == MAP_FAILED) throw std::system_error(err,std::generic_category(),
+      "cannot map "+path);
+    _data = static_cast<const char*>(m);
+  }
+  mapped_file(mapped_file&& o) noexcept
+  : _data(std::exchange(o._data,nullptr)), _size(std::exchange(o._size,0))
+  { }
+  mapped_file& operator=(mapped_file&& o) noexcept {
+    std::swap(_data,o._data);
+    std::swap(_size,o._size);
+    return *this;
+  }
+  ~mapped_file() {
+    if (_data) ::munmap(const_cast<char*>(_data),_size);
+  }
+
+  const char* data() const noexcept { return _data; }
+  size_t size() const noexcept { return _size; }
+  std::string_view view() const noexcept { return { _data, _size }; }
+};
+
+} // end namespace ivanp::hist::detail
+
+#endif
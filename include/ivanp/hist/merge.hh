@@ -0,0 +1,599 @@
+#ifndef IVANP_HISTOGRAMS_MERGE_HH
+#define IVANP_HISTOGRAMS_MERGE_HH
+
+#ifndef IVANP_HISTOGRAMS_HH
+#error "must include histograms.hh first"
+#else
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <optional>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+
+#include <ivanp/hist/json_reader.hh>
+#include <ivanp/hist/json_writer.hh>
+#include <ivanp/hist/mapped_file.hh>
+#include <ivanp/hist/parallel.hh>
+
+// Sums files of histogram dictionaries in the JSON format of README.md,
+// e.g. outputs of jobs with identical bookings.
+// The files are mapped and summed a chunk of bins at a time, so memory
+// does not grow with the number of bins or the number of files.
+// Bins are summed number by number, without knowing the bin types,
+// so their definitions must be null or arrays of names.
+// Sums of integers stay integers. Sparse and dense bins can be mixed.
+
+namespace ivanp::hist {
+
+struct merge_options {
+  unsigned threads = 0;    // 0 for std::thread::hardware_concurrency()
+  size_t chunk = 1 << 14;  // number of bins summed at a time
+  size_t buffer = 1 << 22; // bytes of output a thread may hold back
+  bool sparse = false;     // write the sparse form of the bins
+};
+
+namespace detail {
+
+// Numbers ==========================================================
+
+// sum of JSON numbers, integers are summed exactly
+struct merge_number {
+  int64_t i = 0;
+  double d = 0;
+  bool real = false; // not all numbers are integers
+
+  bool zero() const noexcept { return i == 0 && d == 0; }
+
+  void write(json_writer& w) const {
+    if (real) w.number(d + double(i));
+    else w.number(i);
+  }
+};
+
+inline void merge_add(json_cursor& c, merge_number& x) {
+  c.ws();
+  const char* const p = c.pos();
+  const char* const end = c.end();
+  if (end-p >= 4 && std::memcmp(p,"null",4)==0) { // nonfinite
+    x.d += std::numeric_limits<double>::quiet_NaN();
+    x.real = true;
+    c.seek(p+4);
+    return;
+  }
+  int64_t i;
+  auto r = std::from_chars(p,end,i);
+  if (r.ec == std::errc{} && (r.ptr == end || !std::strchr(".eE",*r.ptr))) {
+    if (int64_t s; __builtin_add_overflow(x.i,i,&s)) {
+      x.d += double(x.i) + double(i);
+      x.i = 0;
+      x.real = true;
+    } else x.i = s;
+  } else {
+    double d;
+    r = std::from_chars(p,end,d);
+    if (r.ec != std::errc{}) c.error("expected number");
+    x.d += d;
+    x.real = true;
+  }
+  c.seek(r.ptr);
+}
+
+// Bins =============================================================
+
+// bin of n numbers, or a single number if not array
+struct merge_bin_shape {
+  unsigned n = 1;
+  bool array = false;
+
+  explicit merge_bin_shape(const nlohmann::json& def) {
+    if (def.is_null()) return;
+    if (!def.is_array() || def.empty()) bad_json(
+      "bins with this definition cannot be summed number by number");
+    for (const auto& name : def)
+      if (!name.is_string()) bad_json(
+        "bins with this definition cannot be summed number by number");
+    n = def.size();
+    array = true;
+  }
+
+  void add(json_cursor& c, merge_number* x) const {
+    if (!array) return merge_add(c,*x);
+    c.expect('[');
+    for (unsigned k=0; k<n; ++k) {
+      if (k) c.expect(',');
+      merge_add(c,x[k]);
+    }
+    c.expect(']');
+  }
+
+  void write(json_writer& w, const merge_number* x) const {
+    if (!array) return x->write(w);
+    w.put('[');
+    for (unsigned k=0; k<n; ++k) {
+      if (k) w.put(',');
+      x[k].write(w);
+    }
+    w.put(']');
+  }
+};
+
+// Inputs ===========================================================
+
+// bins of a histogram in one of the input files
+class merge_bins {
+  json_cursor c;
+  const merge_bin_shape* shape = nullptr;
+  size_t _next = 0, _size = -1;
+  bool _sparse = false, _done = false, in_run = false;
+
+  // moves to the bins of the next nonempty run,
+  // or past the end of the sparse bins object
+  void next_run(bool first) {
+    while (c.next(first,']')) {
+      first = false;
+      c.expect('[');
+      const size_t i = c.number<size_t>();
+      if (i < _next) c.error("overlapping sparse runs");
+      _next = i;
+      c.expect(',');
+      c.expect('[');
+      if (!c.consume(']')) {
+        in_run = true;
+        return;
+      }
+      c.expect(']');
+    }
+    in_run = false;
+    while (c.next(false,'}')) {
+      const auto key = c.string();
+      c.expect(':');
+      if (key == "size") _size = c.number<size_t>();
+      else c.value();
+    }
+    c.expect(']');
+    _done = true;
+  }
+
+public:
+  // c at the histogram object
+  merge_bins(json_cursor c, std::string_view& axes, std::string_view& def)
+  : c(c) {
+    const char* bins = nullptr;
+    this->c.expect('{');
+    for (bool first = true; this->c.next(first,'}'); first = false) {
+      const auto key = this->c.string();
+      this->c.expect(':');
+      if (key == "axes") axes = this->c.value();
+      else {
+        if (key == "bins") bins = this->c.pos();
+        this->c.value();
+      }
+    }
+    if (!bins) this->c.error("histogram without bins");
+    this->c.seek(bins);
+    this->c.expect('[');
+    def = this->c.value();
+    if (!this->c.consume(',')) this->c.error("histogram without bins");
+  }
+
+  // call once the definitions are checked
+  void start(const merge_bin_shape& s) {
+    shape = &s;
+    if (c.consume('[')) return;
+    c.expect('{');
+    _sparse = true;
+    for (bool first = true; c.next(first,'}'); first = false) {
+      const auto key = c.string();
+      c.expect(':');
+      if (key == "size") _size = c.number<size_t>();
+      else if (key == "runs") {
+        c.expect('[');
+        return next_run(true);
+      } else c.value();
+    }
+    c.expect(']');
+    _done = true;
+  }
+
+  // adds bins [lo,hi) to x, with shape->n numbers per bin,
+  // marking the bins it adds in added
+  void add(size_t lo, size_t hi, merge_number* x, char* added) {
+    const unsigned n = shape->n;
+    if (!_sparse) {
+      while (!_done && _next < hi) {
+        if (!c.next(_next==0,']')) {
+          c.expect(']');
+          _size = _next;
+          _done = true;
+          break;
+        }
+        shape->add(c,x + (_next-lo)*n);
+        added[_next-lo] = true;
+        ++_next;
+      }
+    } else {
+      while (in_run && _next < hi) {
+        shape->add(c,x + (_next-lo)*n);
+        added[_next-lo] = true;
+        ++_next;
+        if (!c.consume(',')) {
+          c.expect(']');
+          c.expect(']');
+          next_run(false);
+        }
+      }
+    }
+  }
+
+  // reads the first bin into x, if there is one, without moving past it
+  bool first(merge_number* x) const {
+    json_cursor tmp = c;
+    if (_sparse ? !in_run : (_done || tmp.peek() == ']')) return false;
+    shape->add(tmp,x);
+    return true;
+  }
+
+  bool done() const noexcept { return _done; }
+  size_t next() const noexcept { return _next; }
+  // number of bins, once done
+  size_t size() const {
+    if (_size == size_t(-1)) c.error("sparse bins without size");
+    return _size;
+  }
+};
+
+// Output ===========================================================
+
+// Histograms are written in order. A thread writes the text of its
+// histogram once it is the next one, and until then may hold back up to
+// merge_options::buffer bytes of text.
+class merge_output {
+  json_writer& w;
+  std::mutex m;
+  std::condition_variable cv;
+  size_t head = 0;
+  std::exception_ptr error;
+
+public:
+  explicit merge_output(json_writer& w): w(w) { }
+
+  void write(size_t k, std::string_view text) {
+    {
+      std::unique_lock lock(m);
+      cv.wait(lock,[&]{ return head == k || error; });
+      if (error) std::rethrow_exception(error);
+    }
+    w.raw(text);
+  }
+  void done(size_t k) {
+    { std::lock_guard lock(m); head = k+1; }
+    cv.notify_all();
+  }
+  // wakes the waiting threads, which rethrow the error
+  void fail(std::exception_ptr e) {
+    { std::lock_guard lock(m); if (!error) error = e; }
+    cv.notify_all();
+  }
+};
+
+[[noreturn]] inline void merge_error(
+  const std::string& path, const std::exception& e
+) {
+  throw std::invalid_argument(path+": "+e.what());
+}
+
+inline bool json_space(char c) noexcept {
+  return c==' ' || c=='\n' || c=='\r' || c=='\t';
+}
+
+// definitions are compared as text without whitespace,
+// and parsed only if the text differs, e.g. in the format of numbers
+inline bool same_json(std::string_view a, std::string_view b) {
+  auto p = a.begin(), q = b.begin();
+  for (bool str = false; ; ++p, ++q) {
+    if (!str) {
+      while (p != a.end() && json_space(*p)) ++p;
+      while (q != b.end() && json_space(*q)) ++q;
+    }
+    if (p == a.end() || q == b.end()) {
+      if (p == a.end() && q == b.end()) return true;
+      break;
+    }
+    if (*p != *q) break;
+    if (*p == '\\' && str) {
+      if (++p == a.end() || ++q == b.end() || *p != *q) break;
+    } else if (*p == '"') str = !str;
+  }
+  return nlohmann::json::parse(a.begin(),a.end())
+      == nlohmann::json::parse(b.begin(),b.end());
+}
+
+// text of a definition in the output, in the format of dump()
+inline void write_def(json_writer& w, std::string_view text) {
+  if (std::none_of(text.begin(),text.end(),json_space)) w.raw(text);
+  else w.raw(nlohmann::json::parse(text.begin(),text.end()).dump());
+}
+
+// top level of an input file
+struct merge_file {
+  mapped_file file;
+  nlohmann::json axes, bins;
+  std::vector<std::pair<std::string,const char*>> hists;
+
+  explicit merge_file(const std::string& path): file(path) {
+    try {
+      json_cursor c(file.view());
+      c.expect('{');
+      for (bool first = true; c.next(first,'}'); first = false) {
+        const auto key = c.string();
+        c.expect(':');
+        if (key == "axes") axes = c.dom();
+        else if (key == "bins") bins = c.dom();
+        else if (key == "hists") {
+          c.expect('{');
+          for (bool first = true; c.next(first,'}'); first = false) {
+            auto name = c.string();
+            c.expect(':');
+            hists.emplace_back(std::move(name),c.pos());
+            c.value();
+          }
+        } else c.value();
+      }
+      if (c.peek() != '\0') c.error("unexpected text after the end");
+    } catch (const std::exception& e) { merge_error(path,e); }
+  }
+};
+
+// writes the summed bins, in the dense or the sparse form
+class merge_bins_writer {
+  json_writer& w;
+  const merge_bin_shape& shape;
+  const merge_number* empty;
+  bool sparse, first_run = true;
+  int run = 0; // 0 outside a run, 1 in a run, 2 after an empty bin in a run
+
+public:
+  merge_bins_writer(
+    json_writer& w, const merge_bin_shape& shape,
+    const merge_number* empty, bool sparse
+  ): w(w), shape(shape), empty(empty), sparse(sparse) {
+    w.raw(sparse ? "{\"runs\":[" : "[");
+  }
+
+  // runs go on across single empty bins, like in to_json(sparse_ref)
+  void operator()(size_t i, const merge_number* x) {
+    if (!sparse) {
+      if (i) w.put(',');
+      shape.write(w,x);
+      return;
+    }
+    if (std::all_of(x,x+shape.n,[](const auto& x){ return x.zero(); })) {
+      if (run == 1) run = 2;
+      else if (run == 2) {
+        w.raw("]]");
+        run = 0;
+      }
+      return;
+    }
+    if (run == 0) {
+      if (!first_run) w.put(',');
+      first_run = false;
+      w.put('[').number(i).raw(",[");
+    } else {
+      if (run == 2) { // the empty bin before this one
+        w.put(',');
+        shape.write(w,empty);
+      }
+      w.put(',');
+    }
+    shape.write(w,x);
+    run = 1;
+  }
+
+  void finish(size_t size) {
+    if (!sparse) {
+      w.put(']');
+      return;
+    }
+    if (run) w.raw("]]");
+    w.raw("],\"size\":").number(size).put('}');
+  }
+};
+
+// sums histogram k of the files
+inline void merge_histogram(
+  size_t k,
+  const std::vector<std::unique_ptr<merge_file>>& files,
+  std::span<const std::string> paths,
+  const std::vector<std::vector<const char*>>& pos,
+  merge_output& out, const merge_options& opt
+) {
+  const size_t nfiles = files.size();
+  const auto& first = *files[0];
+
+  // definitions, checked against those in the first file
+  std::vector<merge_bins> in;
+  in.reserve(nfiles);
+  std::string_view axes0, def0;
+  std::optional<merge_bin_shape> shape;
+  for (size_t f=0; f<nfiles; ++f) {
+    try {
+      json_cursor c(files[f]->file.view());
+      c.seek(pos[f][k]);
+      std::string_view axes, def;
+      auto& b = in.emplace_back(c,axes,def);
+      if (f == 0) {
+        axes0 = axes;
+        def0 = def;
+        shape.emplace(resolve_def(
+          nlohmann::json::parse(def.begin(),def.end()), &first.bins ));
+      } else {
+        if (!same_json(axes,axes0)) bad_json("axes differ");
+        if (!same_json(def,def0)) bad_json("bin definitions differ");
+      }
+      b.start(*shape);
+    } catch (const std::exception& e) { merge_error(paths[f],e); }
+  }
+  const unsigned n = shape->n;
+
+  // bins that are in none of the files are written
+  // with the number types of the first bin in any file
+  std::vector<merge_number> empty(n), x(n);
+  for (auto& e : empty) e.real = true;
+  for (size_t f=0; f<nfiles; ++f) {
+    try {
+      if (!in[f].first(x.data())) continue;
+    } catch (const std::exception& e) { merge_error(paths[f],e); }
+    for (unsigned j=0; j<n; ++j) empty[j].real = x[j].real;
+    break;
+  }
+
+  std::string text;
+  json_writer w(text,
+    std::min<size_t>(opt.buffer,json_writer::default_buffer_size));
+  auto flush = [&](bool last){
+    w.flush();
+    if (last || text.size() >= opt.buffer) {
+      out.write(k,text);
+      text.clear();
+    }
+  };
+  if (k) w.put(',');
+  w.key(first.hists[k].first).raw("{\"axes\":");
+  write_def(w,axes0);
+  w.raw(",\"bins\":[");
+  write_def(w,def0);
+  w.put(',');
+  merge_bins_writer write(w,*shape,empty.data(),opt.sparse);
+
+  // sum a chunk of bins at a time
+  const size_t chunk = std::max<size_t>(opt.chunk,1);
+  std::vector<merge_number> sum(chunk*n);
+  std::vector<char> added(chunk);
+  size_t nbins = 0; // written
+  for (bool done = false; !done; ) {
+    std::fill(sum.begin(),sum.end(),merge_number{});
+    std::fill(added.begin(),added.end(),false);
+    const size_t lo = nbins;
+    size_t hi = lo + chunk;
+    done = true;
+    for (size_t f=0; f<nfiles; ++f) {
+      try {
+        in[f].add(lo,hi,sum.data(),added.data());
+      } catch (const std::exception& e) { merge_error(paths[f],e); }
+      done &= in[f].done();
+    }
+    if (done) {
+      hi = lo;
+      for (const auto& b : in) hi = std::max(hi,b.next());
+    }
+    for (; nbins<hi; ++nbins)
+      write(nbins, added[nbins-lo] ? &sum[(nbins-lo)*n] : empty.data());
+    flush(false);
+  }
+
+  // all files must have the same number of bins
+  const size_t size = in[0].size();
+  for (size_t f=0; f<nfiles; ++f) {
+    try {
+      if (in[f].size() != size) bad_json("number of bins differs");
+      if (in[f].next() > size) bad_json("sparse bins past the last bin");
+    } catch (const std::exception& e) { merge_error(paths[f],e); }
+  }
+  while (nbins < size) { // empty bins after the last sparse run
+    for (const size_t end = std::min(nbins+chunk,size); nbins<end; ++nbins)
+      write(nbins,empty.data());
+    flush(false);
+  }
+
+  write.finish(size);
+  w.raw("]}");
+  flush(true);
+}
+
+} // end namespace detail
+
+// Writes the sum of the input files to w.
+// All files must have the same histograms, in any order, with the same
+// axes and bin definitions, and the same global "axes" and "bins" arrays.
+// Other fields are not copied. Histograms are written in the order of
+// the first file, and are summed in parallel by merge_options::threads.
+inline void merge_json(
+  std::span<const std::string> paths, json_writer& w,
+  const merge_options& opt = { }
+) {
+  using namespace detail;
+  if (paths.empty()) throw std::invalid_argument("no files to merge");
+  const size_t nfiles = paths.size();
+
+  // map the files and find the histograms
+  std::vector<std::unique_ptr<merge_file>> files(nfiles);
+  parallel_for(nfiles,opt.threads,[&](size_t f){
+    files[f] = std::make_unique<merge_file>(paths[f]);
+  });
+
+  // positions of the histograms in the order of the first file,
+  // the shared definitions are checked once per file
+  const auto& first = *files[0];
+  const size_t nhists = first.hists.size();
+  std::unordered_map<std::string_view,size_t> index;
+  index.reserve(nhists);
+  for (size_t k=0; k<nhists; ++k)
+    if (!index.emplace(first.hists[k].first,k).second)
+      merge_error(paths[0],std::invalid_argument(
+        "duplicate histogram \""+first.hists[k].first+"\""));
+  std::vector<std::vector<const char*>> pos(nfiles);
+  for (size_t f=0; f<nfiles; ++f) {
+    auto& file = *files[f];
+    if (file.axes != first.axes) merge_error(paths[f],std::invalid_argument(
+      "global axes differ from those in "+paths[0]));
+    if (file.bins != first.bins) merge_error(paths[f],std::invalid_argument(
+      "global bin definitions differ from those in "+paths[0]));
+    if (file.hists.size() != nhists) merge_error(paths[f],
+      std::invalid_argument("number of histograms differs from "+paths[0]));
+    pos[f].resize(nhists);
+    for (auto& [name,p] : file.hists) {
+      const auto it = index.find(name);
+      if (it == index.end() || pos[f][it->second])
+        merge_error(paths[f],std::invalid_argument(
+          "histogram \""+name+"\" is not in "+paths[0]));
+      pos[f][it->second] = p;
+    }
+    if (f) file.hists = { };
+  }
+
+  w.put('{');
+  if (!first.axes.is_null()) w.key("axes").raw(first.axes.dump()).put(',');
+  if (!first.bins.is_null()) w.key("bins").raw(first.bins.dump()).put(',');
+  w.key("hists").put('{');
+
+  merge_output out(w);
+  parallel_for(nhists,opt.threads,[&](size_t k){
+    try {
+      detail::merge_histogram(k,files,paths,pos,out,opt);
+      out.done(k);
+    } catch (...) {
+      out.fail(std::current_exception());
+      throw;
+    }
+  });
+
+  w.raw("}}");
+}
+
+} // end namespace ivanp::hist
+
+#endif
+#endif
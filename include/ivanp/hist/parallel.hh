@@ -0,0 +1,44 @@
+#ifndef IVANP_HISTOGRAMS_PARALLEL_HH
+#define IVANP_HISTOGRAMS_PARALLEL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ivanp::hist::detail {
+
+// calls f(i) for i in [0,n), taking i in increasing order from
+// nthreads threads, or all cores if 0, and rethrows the first exception
+template <typename F>
+void parallel_for(size_t n, unsigned nthreads, F&& f) {
+  if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+  if (nthreads < 2 || n < 2) {
+    for (size_t i=0; i<n; ++i) f(i);
+    return;
+  }
+  std::atomic<size_t> next = 0;
+  std::exception_ptr error;
+  std::mutex m;
+  auto work = [&]{
+    for (size_t i; (i = next++) < n; ) {
+      try {
+        f(i);
+      } catch (...) {
+        next = n;
+        std::lock_guard lock(m);
+        if (!error) error = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads(std::min<size_t>(nthreads,n));
+  for (auto& t : threads) t = std::thread(work);
+  for (auto& t : threads) t.join();
+  if (error) std::rethrow_exception(error);
+}
+
+} // end namespace ivanp::hist::detail
+
+#endif
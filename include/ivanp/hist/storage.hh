@@ -0,0 +1,262 @@
+#ifndef IVANP_HISTOGRAMS_STORAGE_HH
+#define IVANP_HISTOGRAMS_STORAGE_HH
+
+#include <vector>
+#include <span>
+#include <iterator>
+#include <algorithm>
+
+#include <ivanp/hist/axes.hh>
+#include <ivanp/hist/bins.hh>
+
+namespace ivanp::hist {
+
+// Mixed precision bins ============================================
+// Fills accumulate into compact Hot bins, which are folded into Master
+// bins. Every mutable element access is counted as a fill, and all bins
+// are folded after FoldPeriod fills, so that no Hot bin accumulates more
+// than FoldPeriod fills between folds. Filling only touches the Hot bins
+// and one counter. A fold adds all size() bins, so FoldPeriod should not
+// be much smaller than size().
+// Const access and iteration return Master plus Hot by value,
+// without folding.
+template <
+  typename Hot = ww2_bin<float>,
+  typename Master = ww2_bin<double>,
+  index_type FoldPeriod = (1u << 16)
+>
+class promoted_bins {
+public:
+  using value_type = Hot;
+  using master_type = Master;
+  using size_type = size_t;
+  static constexpr index_type fold_period = FoldPeriod;
+  static_assert(FoldPeriod > 0);
+
+private:
+  std::vector<value_type> _hot;
+  std::vector<master_type> _master;
+  index_type _nfill = 0; // fills since the last fold
+
+  void fold(size_type i) {
+    _master[i] += _hot[i];
+    _hot[i] = { };
+  }
+
+  class iter {
+    const promoted_bins* bins;
+    size_type i;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = master_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = master_type;
+    using pointer = void;
+
+    iter() noexcept = default;
+    iter(const promoted_bins* bins, size_type i) noexcept
+    : bins(bins), i(i) { }
+
+    master_type operator*() const { return (*bins)[i]; }
+
+    iter& operator++() noexcept { ++i; return *this; }
+    iter operator++(int) noexcept { auto tmp = *this; ++i; return tmp; }
+
+    bool operator==(const iter& o) const noexcept { return i == o.i; }
+  };
+
+public:
+  using const_iterator = iter;
+
+  void resize(size_type n) {
+    _hot.resize(n);
+    _master.resize(n);
+  }
+  void reserve(size_type n) {
+    _hot.reserve(n);
+    _master.reserve(n);
+  }
+  size_type size() const noexcept { return _hot.size(); }
+
+  value_type& operator[](size_type i) {
+    if (_nfill == fold_period) [[unlikely]] fold();
+    ++_nfill;
+    return _hot[i];
+  }
+  master_type operator[](size_type i) const { return master(i); }
+
+  void fold() {
+    for (size_type i=0, n=_hot.size(); i<n; ++i) fold(i);
+    _nfill = 0;
+  }
+
+  // total of bin i
+  master_type master(size_type i) const {
+    master_type m = _master[i];
+    m += _hot[i];
+    return m;
+  }
+  // bin i folded, e.g. to load the totals
+  master_type& master(size_type i) {
+    fold(i);
+    return _master[i];
+  }
+
+  // move bin k of o here, as bin i
+  void move_bin(size_type i, promoted_bins& o, size_type k) {
+    o.fold(k);
+    _master[i] = std::move(o._master[k]);
+    o._master[k] = { };
+  }
+
+  const_iterator begin() const noexcept { return { this, 0 }; }
+  const_iterator   end() const noexcept { return { this, size() }; }
+
+  promoted_bins& operator+=(const promoted_bins& o) {
+    for (size_type i=0, n=std::min(size(),o.size()); i<n; ++i)
+      _master[i] += o.master(i);
+    return *this;
+  }
+};
+
+// Chunked bins ====================================================
+// Bins stored in separately allocated chunks of 2^ChunkBits,
+// so that very large histograms do not need one contiguous allocation,
+// and resizing does not move existing bins.
+template <typename Bin, unsigned ChunkBits = 20>
+class chunked_bins {
+public:
+  using value_type = Bin;
+  using size_type = size_t;
+  static constexpr size_type chunk_size = size_type(1) << ChunkBits;
+
+private:
+  std::vector<std::vector<value_type>> _chunks;
+  size_type _size = 0;
+
+  template <bool Const>
+  class iter {
+    using bins_t = std::conditional_t<Const,const chunked_bins,chunked_bins>;
+    bins_t* bins;
+    size_type i;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = chunked_bins::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const,const value_type&,value_type&>;
+    using pointer = std::conditional_t<Const,const value_type*,value_type*>;
+
+    iter() noexcept = default;
+    iter(bins_t* bins, size_type i) noexcept: bins(bins), i(i) { }
+
+    reference operator*() const noexcept { return (*bins)[i]; }
+    pointer operator->() const noexcept { return &(*bins)[i]; }
+    iter& operator++() noexcept { ++i; return *this; }
+    iter operator++(int) noexcept { auto it = *this; ++i; return it; }
+    bool operator==(const iter& o) const noexcept { return i == o.i; }
+  };
+
+public:
+  using iterator = iter<false>;
+  using const_iterator = iter<true>;
+
+  void resize(size_type n) {
+    const size_type nc = (n + chunk_size-1) >> ChunkBits;
+    // bins past the new size are reset, as if they were destroyed
+    for (size_type i=n; i<_size && (i >> ChunkBits) < nc; ++i)
+      (*this)[i] = { };
+    _chunks.resize(nc);
+    for (auto& c : _chunks)
+      if (c.empty()) c.resize(chunk_size);
+    _size = n;
+  }
+  size_type size() const noexcept { return _size; }
+  size_type nchunks() const noexcept { return _chunks.size(); }
+
+  value_type& operator[](size_type i) noexcept {
+    return _chunks[i >> ChunkBits][i & (chunk_size-1)];
+  }
+  const value_type& operator[](size_type i) const noexcept {
+    return _chunks[i >> ChunkBits][i & (chunk_size-1)];
+  }
+
+  // bins in chunk k, the last one may be partially used
+  std::span<value_type> chunk(size_type k) noexcept {
+    return { _chunks[k].data(), std::min(chunk_size,_size-(k<<ChunkBits)) };
+  }
+  std::span<const value_type> chunk(size_type k) const noexcept {
+    return { _chunks[k].data(), std::min(chunk_size,_size-(k<<ChunkBits)) };
+  }
+
+  iterator begin() noexcept { return { this, 0 }; }
+  iterator   end() noexcept { return { this, _size }; }
+  const_iterator begin() const noexcept { return { this, 0 }; }
+  const_iterator   end() const noexcept { return { this, _size }; }
+
+  chunked_bins& operator+=(const chunked_bins& o) {
+    for (size_type i=0, n=std::min(_size,o._size); i<n; ++i)
+      (*this)[i] += o[i];
+    return *this;
+  }
+};
+
+// Tracked bins ====================================================
+// Contiguous bins with a dirty flag for every page of 2^PageBits bins.
+// Every mutable element access marks its page as dirty, so that only
+// the pages changed since the last clean() need to be saved.
+// Resizing marks all pages as dirty.
+template <typename Bin, unsigned PageBits = 12>
+class tracked_bins {
+public:
+  using value_type = Bin;
+  using size_type = size_t;
+  using const_iterator = const value_type*;
+  static constexpr size_type page_size = size_type(1) << PageBits;
+
+private:
+  std::vector<value_type> _bins;
+  std::vector<char> _dirty;
+
+public:
+  void resize(size_type n) {
+    _bins.resize(n);
+    _dirty.assign((n + page_size-1) >> PageBits, true);
+  }
+  size_type size() const noexcept { return _bins.size(); }
+  size_type npages() const noexcept { return _dirty.size(); }
+
+  value_type& operator[](size_type i) noexcept {
+    _dirty[i >> PageBits] = true;
+    return _bins[i];
+  }
+  const value_type& operator[](size_type i) const noexcept {
+    return _bins[i];
+  }
+
+  bool dirty(size_type k) const noexcept { return _dirty[k]; }
+  bool dirty() const noexcept {
+    return std::find(_dirty.begin(),_dirty.end(),true) != _dirty.end();
+  }
+  void clean() noexcept { std::fill(_dirty.begin(),_dirty.end(),false); }
+
+  // bins in page k, the last one may be partially used
+  std::span<const value_type> page(size_type k) const noexcept {
+    const size_type i = k << PageBits;
+    return { _bins.data() + i, std::min(page_size,_bins.size()-i) };
+  }
+
+  // read-only, writes go through operator[]
+  const value_type* data() const noexcept { return _bins.data(); }
+  const_iterator begin() const noexcept { return _bins.data(); }
+  const_iterator   end() const noexcept { return _bins.data()+_bins.size(); }
+
+  tracked_bins& operator+=(const tracked_bins& o) {
+    for (size_type i=0, n=std::min(size(),o.size()); i<n; ++i)
+      (*this)[i] += o[i];
+    return *this;
+  }
+};
+
+} // end namespace ivanp::hist
+
+#endif
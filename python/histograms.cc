@@ -1,5 +1,6 @@
 #include <string_view>
 #include <sstream>
+#include <deque>
 
 #define STR1(x) #x
 #define STR(x) STR1(x)
@@ -24,8 +25,6 @@ namespace ivanp::hist {
 namespace {
 using namespace ivanp::python;
 
-// TODO: fix __reduce__ expanding uniform axis
-
 using edge_type = double;
 
 static PyObject *sentinel_one, *double_zero;
@@ -43,7 +42,8 @@ struct py_axis {
 
   using axis_type = variant_axis<
     uniform_axis<edge_type>,
-    cont_axis<std::vector<edge_type>>
+    cont_axis<std::vector<edge_type>>,
+    log_uniform_axis<edge_type>
   >;
   axis_type axis;
 
@@ -62,6 +62,7 @@ struct py_axis {
     std::vector<edge_type> edges;
     index_type ndiv = 0;
     edge_type min, max;
+    bool log = false;
 
     auto iter = get_iter(args); // guaranteed tuple
     auto arg = get_next(iter);
@@ -79,6 +80,11 @@ struct py_axis {
         } else if (auto* ax = std::get_if<1>(ptr)) {
           auto& src = ax->edges();
           edges.insert(edges.end(), src.begin(), src.end());
+        } else if (auto* ax = std::get_if<2>(ptr)) {
+          ndiv = ax->ndiv();
+          min = ax->min();
+          max = ax->max();
+          log = true;
         }
       } else if (auto subiter = get_iter(arg)) { // uniform chunk
         // Note: strings are also iterable and will enter here
@@ -99,7 +105,9 @@ struct py_axis {
         if (subarg) { // flags
           const auto flag = unpy_check<std::string_view>(subarg);
           if (flag == "log") {
-            // TODO: logarithmic spacing
+            if (!(min > 0 && max > 0)) throw error(PyExc_ValueError,
+              "logarithmic axis requires positive edges");
+            log = true;
           } else uniform_args_error();
 
           if (get_next(subiter)) // too many elements
@@ -114,18 +122,26 @@ struct py_axis {
       // set up for next iteration
       arg = get_next(iter);
       if (ndiv && (arg || !edges.empty())) {
-        const edge_type d = (max - min)/ndiv;
         edges.reserve(edges.size()+ndiv+1);
-        for (index_type i=0; i<=ndiv; ++i)
-          edges.push_back(min + i*d);
+        if (log) {
+          const log_uniform_axis<edge_type> ax(min, max, ndiv);
+          for (index_type i=0; i<=ndiv; ++i)
+            edges.push_back(ax.edge(i));
+        } else {
+          const edge_type d = (max - min)/ndiv;
+          for (index_type i=0; i<=ndiv; ++i)
+            edges.push_back(min + i*d);
+        }
         ndiv = 0;
+        log = false;
       }
       if (!arg) break;
     }
 
     // make the axis
     if (edges.empty()) {
-      (*axis).emplace<0>(ndiv, min, max);
+      if (log) (*axis).emplace<2>(min, max, ndiv);
+      else (*axis).emplace<0>(min, max, ndiv);
     } else {
       std::sort( begin(edges), end(edges) );
       edges.erase( std::unique( begin(edges), end(edges) ), end(edges) );
@@ -151,6 +167,11 @@ struct py_axis {
          << ", min: " << ax->min()
          << ", max: " << ax->max()
          << " }";
+    } else if (auto* ax = std::get_if<2>(&*axis)) {
+      ss << "axis: { ndiv: " << ax->ndiv()
+         << ", min: " << ax->min()
+         << ", max: " << ax->max()
+         << ", log }";
     } else if (auto* ax = std::get_if<1>(&*axis)) {
       ss << "axis: [ ";
       bool first = true;
@@ -195,6 +216,34 @@ struct axis_iter_py_type: PyTypeObject {
   }
 } axis_iter_py_type;
 
+// Coordinates read from a buffer of doubles, such as a numpy array,
+// without a copy, or else copied from any iterable
+class coord_column {
+  py_buffer<edge_type> buf;
+  std::vector<edge_type> xs;
+public:
+  explicit coord_column(PyObject* arg): buf(arg) {
+    if (buf) return;
+    auto iter = get_iter(arg);
+    if (!iter) throw existing_error{};
+    while (auto x = get_next(iter))
+      xs.push_back(unpy_check<edge_type>(x));
+    if (PyErr_Occurred()) throw existing_error{};
+  }
+  std::span<const edge_type> operator*() const noexcept {
+    if (buf) return *buf;
+    return xs;
+  }
+};
+
+PyObject* py_tuple(std::span<const index_type> ii) noexcept {
+  PyObject* const tup = PyTuple_New(ii.size());
+  auto* const t = tuple_items(tup);
+  for (size_t i=0; i<ii.size(); ++i)
+    t[i] = py(ii[i]);
+  return tup;
+}
+
 PyMethodDef axis_methods[] {
   { "nbins", (PyCFunction) +[](py_axis* self) noexcept {
       return py((*self)->nbins());
@@ -211,6 +260,15 @@ PyMethodDef axis_methods[] {
         return py((*self)->find_bin_index(unpy_check<edge_type>(arg)));
       } catch (...) { lipp(); return nullptr; }
     }, METH_O, "find bin by coordinate" },
+  { "find_bin_indices", (PyCFunction) +[](py_axis* self, PyObject* arg)
+    noexcept -> PyObject* {
+      try {
+        const coord_column xs(arg);
+        std::vector<index_type> ii((*xs).size());
+        (*self)->find_bin_indices(*xs,ii);
+        return py_tuple(ii);
+      } catch (...) { lipp(); return nullptr; }
+    }, METH_O, "find bins for a sequence of coordinates" },
   { "edge", (PyCFunction) +[](py_axis* self, PyObject* arg) noexcept
     -> PyObject* {
       try {
@@ -248,11 +306,18 @@ PyMethodDef axis_methods[] {
         x[0] = py(axis->ndiv());
         x[1] = py(axis->min());
         x[2] = py(axis->max());
+      } else if (auto* axis = std::get_if<2>(&***self)) {
+        auto* x = tuple_items((
+          tuple_items(( t[1] = PyTuple_New(1) ))[0] = PyTuple_New(4) ));
+        x[0] = py(axis->ndiv());
+        x[1] = py(axis->min());
+        x[2] = py(axis->max());
+        x[3] = py("log");
       } else if (auto* axis = std::get_if<1>(&***self)) {
         using namespace ivanp::cont;
         map<map_flags::no_size_check>([](auto& to, edge_type from){
           to = py(from);
-        }, tuple_span(PyTuple_New(axis->nedges())), axis->edges());
+        }, tuple_span(( t[1] = PyTuple_New(axis->nedges()) )), axis->edges());
       }
       TEST(unpy<std::string_view>(PyObject_Str(py(self))))
       TEST(unpy<std::string_view>(PyObject_Str(tup)))
@@ -532,6 +597,26 @@ PyMethodDef hist_methods[] {
         ));
       } catch(...) { lipp(); return nullptr; }
     }, METH_VARARGS, "bin at given coordinates" },
+  { "find_bin_indices", (PyCFunction) +[](py_hist* self, PyObject* args)
+    noexcept -> PyObject* {
+      try {
+        const auto args_span = tuple_span(args);
+        if (args_span.size() != self->h.ndim()) throw error(PyExc_TypeError,
+          "histogram.find_bin_indices() takes one coordinate column per axis");
+        std::deque<coord_column> cols_data;
+        std::vector<std::span<const edge_type>> cols;
+        cols.reserve(args_span.size());
+        for (PyObject* arg : args_span)
+          cols.push_back(*cols_data.emplace_back(arg));
+        const size_t n = cols.empty() ? 0 : cols.front().size();
+        for (const auto& col : cols)
+          if (col.size() != n) throw error(PyExc_ValueError,
+            "coordinate columns must have the same length");
+        std::vector<index_type> ii(n);
+        self->h.find_bin_indices(cols,ii);
+        return py_tuple(ii);
+      } catch(...) { lipp(); return nullptr; }
+    }, METH_VARARGS, "bin indices from columns of coordinates" },
   { "fill_at", (PyCFunction) +[](py_hist* self, PyObject* args) noexcept
     -> PyObject* {
       try {
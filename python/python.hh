@@ -125,9 +125,10 @@ template <typename T>
   } else
   if constexpr (stringlike<T>) {
     // https://docs.python.org/3/c-api/unicode.html
-    const size_t len = PyUnicode_GET_DATA_SIZE(p);
-    if (len==0) return { };
-    return { PyUnicode_AS_DATA(p), len };
+    Py_ssize_t len = 0;
+    const char* str = PyUnicode_AsUTF8AndSize(p,&len);
+    if (!str || len==0) return { };
+    return { str, size_t(len) };
   }
 }
 
@@ -221,6 +222,38 @@ public:
   const PyObject* operator+() const noexcept { return p; }
 };
 
+// Buffer protocol ==================================================
+
+// View of a contiguous one-dimensional buffer of floating point numbers
+// https://docs.python.org/3/c-api/buffer.html
+template <typename T> requires std::is_floating_point_v<T>
+class py_buffer {
+  Py_buffer buf;
+  bool ok = false;
+public:
+  explicit py_buffer(PyObject* obj) noexcept {
+    if (!PyObject_CheckBuffer(obj)) return;
+    if (PyObject_GetBuffer(obj,&buf,PyBUF_C_CONTIGUOUS|PyBUF_FORMAT)) {
+      PyErr_Clear();
+      return;
+    }
+    std::string_view fmt = buf.format ? buf.format : "B";
+    if (!fmt.empty() && (fmt[0]=='@' || fmt[0]=='=')) fmt.remove_prefix(1);
+    ok = buf.ndim==1 && buf.itemsize==sizeof(T)
+      && fmt == (std::is_same_v<T,double> ? "d" : "f");
+    if (!ok) PyBuffer_Release(&buf);
+  }
+  ~py_buffer() { if (ok) PyBuffer_Release(&buf); }
+
+  py_buffer(const py_buffer&) = delete;
+  py_buffer& operator=(const py_buffer&) = delete;
+
+  explicit operator bool() const noexcept { return ok; }
+  std::span<const T> operator*() const noexcept {
+    return { static_cast<const T*>(buf.buf), size_t(buf.len)/sizeof(T) };
+  }
+};
+
 // Iteration ========================================================
 
 py_ptr get_iter(PyObject* obj) noexcept {
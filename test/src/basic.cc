@@ -1,7 +1,20 @@
 #include <ivanp/hist/histograms.hh>
+#include <ivanp/hist/bins.hh>
+#include <ivanp/hist/storage.hh>
+#include <ivanp/hist/axis_registry.hh>
+#include <ivanp/hist/json.hh>
+#include <ivanp/hist/json_reader.hh>
+#include <ivanp/hist/json_writer.hh>
+#include <ivanp/hist/binary.hh>
+#include <ivanp/hist/merge.hh>
 #include <climits>
 #include <array>
 #include <list>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+#include <random>
 
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
@@ -120,3 +133,1116 @@ TEST_CASE( "generic container constructor", "[hist]" ) {
 
   REQUIRE( h.nbins() == 16 );
 }
+
+TEST_CASE( "compensated bins", "[bins]" ) {
+  using namespace ivanp::hist;
+  const std::vector<double> ws(1000, 1.);
+
+  ww2_bin<> a;
+  compensated_ww2_bin<> b, c;
+  a += 1e16;
+  b += 1e16;
+  c += 1e16;
+  for (double w : ws) {
+    a += w;
+    b += w;
+  }
+  c.accumulate(ws);
+
+  REQUIRE( a.w == 1e16 );
+  REQUIRE( b.w.value() == 1e16 + 1000 );
+  REQUIRE( c.w.value() == 1e16 + 1000 );
+  REQUIRE( c.w2.value() == b.w2.value() );
+
+  compensated_mc_bin<> d;
+  d.accumulate(ws);
+  REQUIRE( d.n == ws.size() );
+  REQUIRE( d.w.value() == 1000 );
+}
+
+TEST_CASE( "stat_bin moments and merging", "[bins]" ) {
+  using namespace ivanp::hist;
+  const std::vector<double> xs { 1.5, 2, 3.25, 7, 4, 4.5, 0.5, 9, 3, 2.75 };
+  const double n = xs.size();
+
+  double mean = 0;
+  for (double x : xs) mean += x;
+  mean /= n;
+  double m2 = 0, m3 = 0, m4 = 0;
+  for (double x : xs) {
+    const double d = x - mean;
+    m2 += d*d;
+    m3 += d*d*d;
+    m4 += d*d*d*d;
+  }
+  const double skew = std::sqrt(n)*m3/std::pow(m2,1.5);
+  const double kurt = n*m4/(m2*m2) - 3;
+
+  stat_bin<4> a, b, c, batch;
+  for (double x : xs) a(x);
+  for (unsigned i=0; i<4; ++i) b(xs[i]);
+  for (unsigned i=4; i<n; ++i) c(xs[i]);
+  b += c;
+  batch(xs);
+
+  for (const auto* s : { &a, &b, &batch }) {
+    REQUIRE( s->n == xs.size() );
+    REQUIRE( s->total() == Approx(n) );
+    REQUIRE( s->mean() == Approx(mean) );
+    REQUIRE( s->variance() == Approx(m2/(n-1)) );
+    REQUIRE( s->skewness() == Approx(skew) );
+    REQUIRE( s->kurtosis() == Approx(kurt) );
+  }
+
+  stat_bin<4> w1, w2;
+  for (double x : xs) w1(x,2.5);
+  w2(xs,std::vector<double>(xs.size(),2.5));
+  REQUIRE( w1.total() == Approx(2.5*n) );
+  REQUIRE( w1.mean() == Approx(mean) );
+  REQUIRE( w1.skewness() == Approx(skew) );
+  REQUIRE( w1.kurtosis() == Approx(kurt) );
+  REQUIRE( w2.mean() == Approx(mean) );
+  REQUIRE( w2.skewness() == Approx(skew) );
+  REQUIRE( w2.kurtosis() == Approx(kurt) );
+
+  stat_bin<4> z;
+  z(xs,std::vector<double>(xs.size(),0.));
+  REQUIRE( z.n == xs.size() );
+  REQUIRE( z.total() == 0 );
+  z(xs);
+  REQUIRE( z.n == 2*xs.size() );
+  REQUIRE( z.mean() == Approx(mean) );
+}
+
+TEST_CASE( "float bins promoted to double", "[bins]" ) {
+  using namespace ivanp::hist;
+  using hist_t = histogram<
+    ww2_bin<float>,
+    bins_spec< promoted_bins<ww2_bin<float>,ww2_bin<double>,1000> >
+  >;
+  hist_t h(std::vector<cont_axis<>>{ {0.,1.,2.} });
+  REQUIRE( h.nbins() == 4 );
+
+  ww2_bin<float> plain;
+  for (unsigned i=0; i<1000000; ++i) {
+    h({0.5},0.1);
+    plain += 0.1;
+  }
+  h({1.5});
+
+  const auto& bins = h.bins();
+  REQUIRE( bins.master(1).w == Approx(1e5).epsilon(1e-4) );
+  REQUIRE( bins.master(1).w2 == Approx(1e4).epsilon(1e-4) );
+  REQUIRE( bins.master(2).w == 1 );
+  REQUIRE( std::abs(plain.w - 1e5) > 1e-3*1e5 );
+
+  double total = 0;
+  for (const auto& b : h) total += b.w;
+  REQUIRE( total == Approx(1e5+1).epsilon(1e-4) );
+
+  hist_t::bins_type sum;
+  sum.resize(4);
+  sum += bins;
+  sum += bins;
+  REQUIRE( sum.master(2).w == 2 );
+
+  // const access returns the totals without folding
+  REQUIRE( std::as_const(h)[{1}].w == bins.master(1).w );
+
+  // all bins are folded after FoldPeriod fills of any bins
+  promoted_bins<ww2_bin<float>,ww2_bin<double>,8> pb;
+  pb.resize(100);
+  for (unsigned i=0; i<5; ++i) ++pb[0];
+  for (unsigned i=0; i<3; ++i) ++pb[1];
+  auto& hot = pb[0];
+  REQUIRE( hot.w == 0 );
+  ++hot;
+  REQUIRE( std::as_const(pb)[0].w == 6 );
+  REQUIRE( std::as_const(pb)[1].w == 3 );
+
+  // growing keeps the totals
+  histogram<
+    ww2_bin<float>,
+    axes_spec<std::vector<growable_uniform_axis<>>>,
+    bins_spec< promoted_bins<ww2_bin<float>,ww2_bin<double>,8> >
+  > g(std::vector<growable_uniform_axis<>>{ {0,4,4} });
+  for (unsigned i=0; i<20; ++i) g({1.5});
+  g({9.5});
+  REQUIRE( g.nbins() == 12 );
+  REQUIRE( std::as_const(g)[{2}].w == 20 );
+  REQUIRE( std::as_const(g)[{10}].w == 1 );
+
+  // totals are loaded into the double bins
+  const nlohmann::json j = h;
+  hist_t h2, h3;
+  from_json(j,h2);
+  read_json(j.dump(),h3);
+  for (const auto* x : { &h2, &h3 }) {
+    REQUIRE( x->bins().master(1).w == bins.master(1).w );
+    REQUIRE( x->bins().master(1).w2 == bins.master(1).w2 );
+  }
+}
+
+TEST_CASE( "chunked bins and bin count overflow", "[bins]" ) {
+  using namespace ivanp::hist;
+  using axes_t = std::vector<uniform_axis<double>>;
+  const axes_t axes { { 0, 1, 40 } };
+  histogram<double, axes_spec<axes_t>, bins_spec< chunked_bins<double,4> >>
+    h(axes);
+  histogram<double, axes_spec<axes_t>> v(axes);
+  REQUIRE( h.nbins() == 42 );
+  REQUIRE( h.bins().nchunks() == 3 );
+  REQUIRE( h.bins().chunk(2).size() == 10 );
+
+  for (unsigned i=0; i<1000; ++i) {
+    const double x = (i % 47)*0.025 - 0.05;
+    h({x});
+    v({x});
+  }
+  REQUIRE( std::equal(h.begin(),h.end(),v.begin(),v.end()) );
+
+  // 65536 bins per axis, enough axes to overflow index_type
+  const axes_t big( sizeof(index_type)/2, uniform_axis<double>(0,1,65534) );
+  REQUIRE_THROWS_AS(
+    (histogram<double, axes_spec<axes_t>>(big)), std::length_error );
+}
+
+TEST_CASE( "tracked bins", "[bins]" ) {
+  using namespace ivanp::hist;
+  using axes_t = std::vector<uniform_axis<double>>;
+  histogram<double, axes_spec<axes_t>, bins_spec< tracked_bins<double,4> >>
+    h(axes_t{ { 0, 1, 40 } });
+  const auto& bins = h.bins();
+  REQUIRE( h.nbins() == 42 );
+  REQUIRE( bins.npages() == 3 );
+  REQUIRE( bins.page(2).size() == 10 );
+  REQUIRE( bins.dirty() ); // new bins must be saved
+
+  h.bins().clean();
+  REQUIRE( !bins.dirty() );
+  h({0.5}); // bin 21, page 1
+  REQUIRE( !bins.dirty(0) );
+  REQUIRE(  bins.dirty(1) );
+  REQUIRE( !bins.dirty(2) );
+  REQUIRE( bins.page(1)[5] == 1 );
+}
+
+TEST_CASE( "t-digest quantile bins", "[bins]" ) {
+  using namespace ivanp::hist;
+  histogram<tdigest_bin<>> h(std::vector<cont_axis<>>{ {0.,1.} });
+
+  tdigest_bin<> a, b;
+  for (unsigned i=0; i<100000; ++i) {
+    const double y = (i*7919 % 100000)*1e-5;
+    h({0.5},y);
+    (i%2 ? a : b)(y);
+  }
+  const auto& bin = h.bin_at(1);
+  REQUIRE( bin.n == 100000 );
+  REQUIRE( bin.centroids().size() <= 100 );
+  REQUIRE( bin.median() == Approx(0.5).margin(1e-3) );
+  REQUIRE( bin.quantile(0.01) == Approx(0.01).margin(1e-3) );
+  REQUIRE( bin.quantile(0.99) == Approx(0.99).margin(1e-3) );
+  REQUIRE( bin.quantile(0) == 0 );
+  REQUIRE( bin.quantile(1) == Approx(0.99999) );
+
+  a += b;
+  REQUIRE( a.total() == 100000 );
+  REQUIRE( a.median() == Approx(0.5).margin(1e-3) );
+  REQUIRE( a.quantile(0.9) == Approx(0.9).margin(1e-3) );
+}
+
+TEST_CASE( "profile bins", "[bins]" ) {
+  using namespace ivanp::hist;
+  using hist_t = histogram<
+    profile_bin<>,
+    axes_spec< std::array<uniform_axis<double>,1> >
+  >;
+  hist_t h1(std::array<uniform_axis<double>,1>{{ {0,2,4} }});
+  hist_t h2(h1.axes());
+
+  std::vector<double> xs, ys, ws;
+  for (unsigned i=0; i<1000; ++i) {
+    const double x = i*0.002 - 0.1;
+    xs.push_back(x);
+    ys.push_back(3*x + (i%2 ? 0.5 : -0.5));
+    ws.push_back(1 + i%3);
+    h1({xs.back()}, ys.back(), ws.back());
+  }
+  fill_profile(h2, xs, ys, ws);
+
+  REQUIRE( h1.nbins() == 6 );
+  for (unsigned i=0; i<h1.nbins(); ++i) {
+    const auto& a = h1.bin_at(i);
+    const auto& b = h2.bin_at(i);
+    REQUIRE( a.w == b.w );
+    REQUIRE( a.w2 == b.w2 );
+    REQUIRE( a.wy == Approx(b.wy) );
+    REQUIRE( a.wy2 == Approx(b.wy2) );
+  }
+
+  const auto& b = h2.bin_at(1); // [0,0.5)
+  REQUIRE( b.mean() == Approx(0.75).epsilon(1e-2) );
+  REQUIRE( b.neff() < b.w );
+  REQUIRE( b.error() == Approx(b.stdev()/std::sqrt(b.neff())) );
+
+  hist_t h3(h1.axes());
+  fill_profile(h3, xs, ys);
+  REQUIRE( h3.bin_at(0).w == 50 );
+}
+
+TEST_CASE( "log uniform axis", "[axis]" ) {
+  using namespace ivanp::hist;
+  const log_uniform_axis<double> ax(1e5,1,5);
+
+  REQUIRE( ax.nbins() == 7 );
+  REQUIRE( ax.min() == 1 );
+  REQUIRE( ax.max() == 1e5 );
+  REQUIRE( ax.edge(2) == Approx(100) );
+  REQUIRE( ax.lower(0) == -std::numeric_limits<double>::infinity() );
+  REQUIRE( ax.upper(6) == std::numeric_limits<double>::infinity() );
+
+  REQUIRE( ax.find_bin_index(0.5) == 0 );
+  REQUIRE( ax.find_bin_index(1) == 1 );
+  REQUIRE( ax.find_bin_index(150) == 3 );
+  REQUIRE( ax.find_bin_index(1e5) == 6 );
+  REQUIRE( ax.find_bin_index(-1) == 0 );
+
+  for (index_type i=0; i<ax.nedges(); ++i) {
+    const double e = ax.edge(i);
+    REQUIRE( ax.find_bin_index(e) == i+1 );
+    REQUIRE( ax.find_bin_index(std::nextafter(e,0.)) == i );
+  }
+
+  std::vector<double> xs { 0.1, 1, 3, 10, 99.99, 100, 2e4, 1e5, 1e6 };
+  for (unsigned i=0; i<1000; ++i) xs.push_back(1 + i*123.4567);
+  std::vector<index_type> ii(xs.size());
+  ax.find_bin_indices(xs,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == ax.find_bin_index(xs[i]) );
+}
+
+TEST_CASE( "integer and category axes", "[axes]" ) {
+  using namespace ivanp::hist;
+
+  const integer_axis<> ia(-2,3);
+  REQUIRE( ia.nbins() == 7 );
+  REQUIRE( ia.edge(0) == -2 );
+  REQUIRE( ia.find_bin_index(-3) == 0 );
+  REQUIRE( ia.find_bin_index(-2) == 1 );
+  REQUIRE( ia.find_bin_index(2) == 5 );
+  REQUIRE( ia.find_bin_index(3) == 6 );
+  REQUIRE( ia.find_bin_index(-1.5) == 1 );
+  REQUIRE( ia.find_bin_index(2u) == 5 );
+
+  // the full range of a signed type
+  const integer_axis<short> ia16(SHRT_MIN,SHRT_MAX);
+  REQUIRE( ia16.ndiv() == 65535 );
+  REQUIRE( ia16.find_bin_index(SHRT_MAX-1) == 65535 );
+  if constexpr (sizeof(index_type) < sizeof(long long))
+    REQUIRE_THROWS_AS(
+      integer_axis<long long>(LLONG_MIN,0), std::length_error );
+
+  const std::vector<int> xs { -100, -3, -2, -1, 0, 1, 2, 3, 4, 100 };
+  std::vector<index_type> ii(xs.size());
+  ia.find_bin_indices(xs,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == ia.find_bin_index(xs[i]) );
+
+  const category_axis<> ca { 11, 13, -211, 22 };
+  REQUIRE( ca.nbins() == 5 );
+  REQUIRE( ca.find_bin_index(11) == 1 );
+  REQUIRE( ca.find_bin_index(22) == 4 );
+  REQUIRE( ca.find_bin_index(-211) == 3 );
+  REQUIRE( ca.find_bin_index(211) == 0 );
+  REQUIRE( ca.find_bin_index(13.) == 2 );
+  REQUIRE( ca.find_bin_index(13.5) == 0 );
+  REQUIRE_THROWS_AS( category_axis<>({ 1, 2, 1 }), std::invalid_argument );
+
+  const category_axis<std::string> sa { "ee", "emu", "mumu" };
+  REQUIRE( sa.find_bin_index("emu") == 2 );
+  REQUIRE( sa.find_bin_index("tautau") == 0 );
+
+  histogram<double, axes_spec<std::tuple<
+    integer_axis<>, category_axis<std::string>
+  >>> h(std::make_tuple( integer_axis<>(0,4), sa ));
+  REQUIRE( h.nbins() == 6*4 );
+  h({ 2, "mumu" });
+  h({ 2, "mumu" });
+  h({ 7, "ee" });
+  REQUIRE( h.bin_at(3,3) == 2 );
+  REQUIRE( h.bin_at(5,1) == 1 );
+
+  using var_t = variant_axis< uniform_axis<double>, integer_axis<int> >;
+  const var_t va(std::in_place_index<1>,0,4);
+  REQUIRE( va.find_bin_index(1.5) == 2 );
+  REQUIRE( va.edge(2) == 2. );
+}
+
+TEST_CASE( "growable axes", "[axes]" ) {
+  using namespace ivanp::hist;
+
+  growable_uniform_axis<> ua(0,10,10);
+  REQUIRE( !ua.grow(5.) );
+  REQUIRE( !ua.grow(std::numeric_limits<double>::infinity()) );
+  auto g = ua.grow(12.5);
+  REQUIRE( g.above == 10 );
+  REQUIRE( ua.max() == 20 );
+  g = ua.grow(-35.);
+  REQUIRE( g.below == 36 );
+  REQUIRE( ua.min() == -36 );
+  REQUIRE( ua.nbins() == 58 );
+  REQUIRE( ua.find_bin_index(-35.5) == 1 );
+  REQUIRE( ua.find_bin_index(3.5) == 40 );
+
+  // growth past index_type throws and leaves the axis as it was
+  REQUIRE_THROWS_AS( ua.grow(1e300), std::length_error );
+  REQUIRE_THROWS_AS( ua.grow(-1e300), std::length_error );
+  REQUIRE( ua.nbins() == 58 );
+  REQUIRE( ua.max() == 20 );
+  REQUIRE( ua.min() == -36 );
+
+  histogram<double, axes_spec<std::tuple<
+    category_axis<std::string,true>, growable_uniform_axis<>
+  >>> h(std::make_tuple(
+    category_axis<std::string,true>{ "ee" }, growable_uniform_axis<>(0,4,4)
+  ));
+  REQUIRE( h.nbins() == 2*6 );
+  h({"ee",1.5});
+  h({"ee",-1./0.});
+  h({"ee",1./0.});
+  h({"mumu",2.5});
+  REQUIRE( h.axis<0>().nbins() == 3 );
+  h({"emu",3.5});
+  REQUIRE( h.axis<0>().nbins() == 5 );
+  REQUIRE( h.axis<0>().nlabels() == 3 );
+  h({"ee",9.});
+  REQUIRE( h.axis<1>().max() == 10 );
+  h({"tautau",-1.});
+  REQUIRE( h.axis<1>().min() == -10 );
+  REQUIRE( h.nbins() == 5*22 );
+
+  const auto& c = h.axis<0>();
+  const auto& u = h.axis<1>();
+  REQUIRE( h.bin_at(c("ee"),u(1.5)) == 1 );
+  REQUIRE( h.bin_at(c("ee"),0) == 1 );
+  REQUIRE( h.bin_at(c("ee"),u.nbins()-1) == 1 );
+  REQUIRE( h.bin_at(c("mumu"),u(2.5)) == 1 );
+  REQUIRE( h.bin_at(c("emu"),u(3.5)) == 1 );
+  REQUIRE( h.bin_at(c("ee"),u(9.)) == 1 );
+  REQUIRE( h.bin_at(c("tautau"),u(-1.)) == 1 );
+  double sum = 0;
+  for (double b : h) sum += b;
+  REQUIRE( sum == 7 );
+}
+
+TEST_CASE( "batch lookup", "[axes]" ) {
+  using namespace ivanp::hist;
+  using var_t = variant_axis<
+    uniform_axis<double>, cont_axis<std::vector<double>>, integer_axis<int>
+  >;
+  const var_t a(std::in_place_index<0>,0,10,5),
+              b(std::in_place_index<1>,std::vector<double>{1,2,4,8}),
+              c(std::in_place_index<2>,-1,2);
+
+  const std::vector<double> xs { -1, 0, 0.5, 1, 2.5, 3.9, 7, 9.99, 10, 1e9 };
+  std::vector<index_type> ii(xs.size());
+  for (const var_t* ax : { &a, &b, &c }) {
+    ax->find_bin_indices(xs,ii);
+    for (size_t i=0; i<xs.size(); ++i)
+      REQUIRE( ii[i] == ax->find_bin_index(xs[i]) );
+  }
+
+  histogram<double, axes_spec<std::vector<var_t>>> h(std::vector{ a, b, c });
+  const std::vector<double> ys { 5, 1, 0, 3, 2, 1, 0, 8, 2, -3 },
+                            zs { 0, 1, 0, -1, 2, 5, 1, 0, 1, 1 };
+  const std::array<std::span<const double>,3> cols { xs, ys, zs };
+  h.find_bin_indices(cols,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == h.find_bin_index(xs[i],ys[i],zs[i]) );
+
+  std::vector<index_type> jj(xs.size()+1);
+  REQUIRE_THROWS_AS( h.find_bin_indices(cols,jj), std::length_error );
+}
+
+TEST_CASE( "float and integer edges", "[axes]" ) {
+  using namespace ivanp::hist;
+
+  // doubles must not be rounded to the float edges
+  const float e = 0.1f;
+  const double below = std::nextafter(double(e),0.), above = double(e);
+  const cont_axis<std::vector<float>> fa { 0.f, e, 1.f };
+  REQUIRE( float(below) == e );
+  REQUIRE( fa.find_bin_index(below) == 1 );
+  REQUIRE( fa.find_bin_index(above) == 2 );
+  const uniform_axis<float> fu(e, 1.f, 3);
+  REQUIRE( fu.find_bin_index(below) == 0 );
+  REQUIRE( fu.find_bin_index(above) == 1 );
+
+  std::vector<double> xs { -1, -0., 0, below, above, 0.5, 1, 2, 1e300 };
+  xs.push_back(-1e-300);
+  xs.push_back(std::numeric_limits<double>::quiet_NaN());
+  std::vector<index_type> ii(xs.size());
+  fa.find_bin_indices<double>(xs,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == fa.find_bin_index(xs[i]) );
+  fu.find_bin_indices<double>(xs,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == fu.find_bin_index(xs[i]) );
+
+  // branchless search agrees with upper_bound for any number of edges
+  std::vector<double> edges;
+  for (int ne=0; ne<20; ++ne) {
+    const cont_axis<> ca(edges);
+    ca.find_bin_indices<double>(xs,ii);
+    for (size_t i=0; i<xs.size(); ++i)
+      REQUIRE( ii[i] == ca.find_bin_index(xs[i]) );
+    edges.push_back(ne*0.1-0.5);
+  }
+
+  // exact integer arithmetic for fixed point coordinates
+  const uniform_axis<int> ia(-100, 4000, 7);
+  std::vector<int> ns;
+  for (int n=-200; n<4100; ++n) ns.push_back(n);
+  std::vector<index_type> jj(ns.size());
+  ia.find_bin_indices<int>(ns,jj);
+  for (size_t i=0; i<ns.size(); ++i) {
+    const int n = ns[i];
+    const index_type k = n < -100 ? 0 : n >= 4000 ? 8 : (n+100)*7/4100 + 1;
+    REQUIRE( ia.find_bin_index(n) == k );
+    REQUIRE( jj[i] == k );
+  }
+  // zero width, everything is under- or overflow
+  const uniform_axis<int> za(5, 5, 3);
+  za.find_bin_indices<int>(ns,jj);
+  for (size_t i=0; i<ns.size(); ++i) {
+    REQUIRE( jj[i] == (ns[i] < 5 ? 0 : 4) );
+    REQUIRE( za.find_bin_index(ns[i]) == jj[i] );
+  }
+  const cont_axis<std::vector<std::uint16_t>> ua { 10, 20, 40, 80 };
+  const std::vector<std::uint16_t> adc { 0, 10, 19, 20, 79, 80, 65535 };
+  ua.find_bin_indices<std::uint16_t>(adc,jj);
+  for (size_t i=0; i<adc.size(); ++i)
+    REQUIRE( jj[i] == ua.find_bin_index(adc[i]) );
+  REQUIRE( ua.find_bin_index(-1) == 0 );
+
+  // offset times ndiv overflows 64 bits
+  const uniform_axis<long long> la(0, LLONG_MAX, 1000);
+  REQUIRE( la.find_bin_index(LLONG_MAX/3) == 334 );
+  REQUIRE( la.find_bin_index(LLONG_MAX/2) == 500 );
+  REQUIRE( la.find_bin_index(LLONG_MAX-1) == 1000 );
+}
+
+TEST_CASE( "axes without flow bins", "[axes]" ) {
+  using namespace ivanp::hist;
+  using nf_t = noflow_axis<uniform_axis<double>>;
+
+  const nf_t a(0,10,5);
+  REQUIRE( a.nbins() == 5 );
+  REQUIRE( a.find_bin_index(0.) == 0 );
+  REQUIRE( a.find_bin_index(9.9) == 4 );
+  REQUIRE( a.find_bin_index(-1.) >= a.nbins() );
+  REQUIRE( a.find_bin_index(10.) >= a.nbins() );
+  REQUIRE( a.lower(1) == 2 );
+  REQUIRE( a.upper(1) == 4 );
+
+  histogram<double, axes_spec<std::tuple<
+    nf_t, uniform_axis<double>, noflow_axis<cont_axis<>>
+  >>> h(std::make_tuple( a, uniform_axis<double>(0,1,2), cont_axis<>{0,1,2} ));
+  REQUIRE( h.nbins() == 5*4*2 + 1 );
+
+  REQUIRE( h.find_bin_index(3,0.25,1.5) == (1*4 + 1)*2 + 1 );
+  REQUIRE( h.find_bin_index(3,-5,1.5) == (1*4 + 0)*2 + 1 );
+  REQUIRE( h.find_bin_index(-3,0.25,1.5) == 40 );
+  REQUIRE( h.find_bin_index(3,0.25,2.5) == 40 );
+
+  h(3,0.25,1.5);
+  h(11,0.25,1.5);
+  h(3,0.25,-1);
+  REQUIRE( h.bin_at(1,1,1) == 1 );
+  REQUIRE( h.outside_bin() == 2 );
+
+  const std::vector<double> xs { 3, 3, -3, 3, 1 },
+                            ys { 0.25, -5, 0.25, 0.25, 2 },
+                            zs { 1.5, 1.5, 1.5, 2.5, 0 };
+  const std::array<std::span<const double>,3> cols { xs, ys, zs };
+  std::vector<index_type> ii(xs.size());
+  h.find_bin_indices(cols,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == h.find_bin_index(xs[i],ys[i],zs[i]) );
+}
+
+TEST_CASE( "hinted lookup", "[axes]" ) {
+  using namespace ivanp::hist;
+  const cont_axis<> a{0,1,2,3,5,8,13,21,34,55};
+
+  std::vector<double> xs;
+  for (double x=-2; x<60; x+=0.25) xs.push_back(x);
+  std::vector<index_type> ii(xs.size());
+  a.find_sorted_bin_indices(std::span<const double>(xs),ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == a.find_bin_index(xs[i]) );
+
+  // any hint gives the same index
+  for (double x : xs)
+    for (index_type h=0; h<a.nbins()+2; ++h)
+      REQUIRE( a.find_bin_index(x,h) == a.find_bin_index(x) );
+
+  // unsorted coordinates
+  std::reverse(xs.begin(),xs.end());
+  std::swap(xs[3],xs[100]);
+  const hinted_axis<cont_axis<>> b(a);
+  b.find_bin_indices(std::span<const double>(xs),std::span(ii));
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == a.find_bin_index(xs[i]) );
+  REQUIRE( b.hint() == ii.back() );
+
+  histogram<double, axes_spec<std::tuple<
+    hinted_axis<cont_axis<>>, noflow_axis<hinted_axis<cont_axis<>>>
+  >>> h(std::make_tuple( b, a ));
+  REQUIRE( h.find_bin_index(4,1.5) == 4*9 + 1 );
+  REQUIRE( h.find_bin_index(4.5,100) == h.nbins()-1 );
+
+  const std::vector<double> ys(xs.size(),2.5);
+  const std::array<std::span<const double>,2> cols { xs, ys };
+  h.find_bin_indices(cols,ii);
+  for (size_t i=0; i<xs.size(); ++i)
+    REQUIRE( ii[i] == h.find_bin_index(xs[i],ys[i]) );
+
+  // batch fill of sorted columns, longer than a chunk
+  std::vector<double> xs2, ys2;
+  for (double x=-2; x<60; x+=0.1) {
+    xs2.push_back(x);
+    ys2.push_back(x < 30 ? 1.5 : 100);
+  }
+  auto h2 = h;
+  h.fill_batch(std::array<std::span<const double>,2>{ xs2, ys2 }, 2.);
+  for (size_t i=0; i<xs2.size(); ++i)
+    h2({xs2[i],ys2[i]}, 2.);
+  REQUIRE( h.bins() == h2.bins() );
+  REQUIRE( h.outside_bin() > 0 );
+  REQUIRE_THROWS_AS( h.fill_batch(std::make_tuple(xs2,ys)),
+    std::length_error );
+}
+
+TEST_CASE( "interned axes", "[axes]" ) {
+  using namespace ivanp::hist;
+  using ref_t = axis_ref<cont_axis<>>;
+
+  axis_registry<cont_axis<>> reg;
+  const ref_t a = reg.intern(cont_axis<>{ 0, 1, 2, 5 }),
+              b = reg.intern(std::vector<double>{ 0, 1, 2, 5 }),
+              c = reg.intern(cont_axis<>{ 0, 1, 2, 6 });
+  REQUIRE( a == b );
+  REQUIRE( a.get() == b.get() );
+  REQUIRE( !(a == c) );
+  REQUIRE( reg.size() == 2 );
+
+  histogram<double, axes_spec<std::vector<ref_t>>> h1(std::vector{ a, c }),
+                                                   h2(std::vector{ b, b });
+  REQUIRE( h1.nbins() == 5*5 );
+  REQUIRE( h1.find_bin_index(1.5,5.5) == 2*5+3 );
+  h2(1.5,7);
+  REQUIRE( h2.bin_at(2,4) == 1 );
+
+  { const ref_t d = reg.intern(cont_axis<>{ 3, 4 }); }
+  REQUIRE( reg.size() == 3 );
+  reg.prune();
+  REQUIRE( reg.size() == 2 );
+
+  REQUIRE( intern_axis(uniform_axis<>(0,1,10)).get()
+        == intern_axis(uniform_axis<>(0,1,10)).get() );
+}
+
+TEMPLATE_TEST_CASE( "transformed axes", "[axes]",
+  ivanp::hist::sqrt_transform,
+  ivanp::hist::asinh_transform,
+  ivanp::hist::reciprocal_transform
+) {
+  using namespace ivanp::hist;
+  const transformed_axis<TestType> ax(0.5, 1e4, 37);
+  REQUIRE( ax.nbins() == 39 );
+  REQUIRE( ax.edge(0) == 0.5 );
+  REQUIRE( ax.edge(37) == 1e4 );
+  REQUIRE( ax.lower(1) == 0.5 );
+  REQUIRE( ax.upper(37) == 1e4 );
+
+  std::vector<double> edges(ax.nedges());
+  for (index_type i=0; i<ax.nedges(); ++i) edges[i] = ax.edge(i);
+
+  std::vector<double> xs { -1., 0., 0.5, 1e4, 2e4, 1e300 };
+  for (double e : edges) {
+    xs.push_back(e);
+    xs.push_back(std::nextafter(e,0.));
+    xs.push_back(std::nextafter(e,1e300));
+  }
+  double x = 0.3;
+  for (int i=0; i<2000; ++i) xs.push_back(x *= 1.0071);
+
+  std::vector<index_type> ii(xs.size());
+  ax.find_bin_indices(xs,ii);
+  for (size_t i=0; i<xs.size(); ++i) {
+    const index_type k = std::upper_bound(
+      edges.begin(), edges.end(), xs[i]) - edges.begin();
+    REQUIRE( ax.find_bin_index(xs[i]) == k );
+    REQUIRE( ii[i] == k );
+  }
+
+  REQUIRE_THROWS_AS( transformed_axis<TestType>(3, 3, 3),
+    std::domain_error );
+
+  // fast() is within the stated error bound, also for subnormals
+  xs.insert(xs.end(), { 1e-310, 5e-324, 1e-300, 1e150, 1e308, -1e308 });
+  for (double x : xs) {
+    if (!TestType::domain(x)) continue;
+    const double y = TestType::forward(x);
+    if (std::isinf(y)) continue;
+    REQUIRE( std::abs(TestType::fast(x) - y)
+          <= TestType::fast_error*std::max(1.,std::abs(y)) );
+  }
+}
+
+namespace {
+
+using json_hist_t = ivanp::hist::histogram<
+  ivanp::hist::ww2_bin<double>,
+  ivanp::hist::axes_spec<std::vector<ivanp::hist::uniform_axis<double>>>
+>;
+using json_hists_t = std::map<std::string,std::unique_ptr<json_hist_t>>;
+
+// histograms with shared and distinct axes, empty ones, and a NaN bin
+json_hists_t json_test_hists() {
+  using ivanp::hist::uniform_axis;
+  using axes_t = std::vector<uniform_axis<double>>;
+  const uniform_axis<double> x(0,1,10), y(-2,2,4);
+  json_hists_t hs;
+  auto& a = *(hs["a"] = std::make_unique<json_hist_t>(axes_t{x}));
+  a({0.05});
+  a({0.55},0.5);
+  a({2.},2.25);
+  auto& b = *(hs["b"] = std::make_unique<json_hist_t>(axes_t{x}));
+  b({0.35},std::numeric_limits<double>::quiet_NaN());
+  b({-1.},1.5);
+  auto& c = *(hs["c"] = std::make_unique<json_hist_t>(axes_t{x,y}));
+  for (int i=0; i<40; ++i) c({i*0.025,i*0.1-2},0.125*i);
+  hs["d"] = std::make_unique<json_hist_t>(axes_t{{0,5,5}});
+  return hs;
+}
+
+std::string write_json_string(const auto& x) {
+  std::string s;
+  { ivanp::hist::json_writer w(s);
+    write_json(w,x);
+  }
+  return s;
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream f(path, std::ios::binary);
+  return { std::istreambuf_iterator<char>(f), {} };
+}
+void write_file(const std::string& path, std::string_view data) {
+  std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+}
+std::string temp_path(const char* name) {
+  return (std::filesystem::temp_directory_path()/name).string();
+}
+
+} // end namespace
+
+TEST_CASE( "json writer matches dump", "[json]" ) {
+  using namespace ivanp::hist;
+  const auto hs = json_test_hists();
+  REQUIRE( write_json_string(hs) == to_json(hs).dump() );
+  REQUIRE( write_json_string(as_sparse(hs))
+        == nlohmann::json(as_sparse(hs)).dump() );
+  REQUIRE( to_json(hs).dump().find("null") != std::string::npos );
+}
+
+TEST_CASE( "json dictionary de-duplication", "[json]" ) {
+  using namespace ivanp::hist;
+  using detail::json_hash;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  REQUIRE( json_hash(1) == json_hash(1.) );
+  REQUIRE( json_hash(-0.) == json_hash(0.) );
+  REQUIRE( json_hash({0,1u,2}) == json_hash({0.,1.,2.}) );
+
+  // the first of the equal definitions is kept,
+  // axes with NaN edges are never equal
+  using hist_t = histogram<double, axes_spec<std::tuple<
+    cont_axis<std::vector<int>,int>, cont_axis<> >>>;
+  std::map<std::string,std::unique_ptr<hist_t>> hs;
+  const auto add = [&](const char* name,
+    std::vector<int> a, std::vector<double> b
+  ) {
+    hs[name] = std::make_unique<hist_t>(std::make_tuple(a,b));
+  };
+  add("a", {0,1,2}, {0.,1.,2.});
+  add("b", {0,1,2}, {-0.,1.,2.});
+  add("c", {0,1,3}, {-0.,nan});
+  add("d", {0,1,3}, {0.,nan});
+  add("e", {0,1,3}, {1.,2.});
+  const auto j = to_json(hs);
+  REQUIRE( j["axes"].dump() ==
+    "[[0,1,2],[0,1,3],[-0.0,null],[0.0,null],[1.0,2.0]]" );
+  const char* names[] { "a", "b", "c", "d", "e" };
+  const char* ids[] { "[0,0]", "[0,0]", "[1,2]", "[1,3]", "[1,4]" };
+  for (int i=0; i<5; ++i)
+    REQUIRE( j["hists"][names[i]]["axes"].dump() == ids[i] );
+}
+
+TEST_CASE( "json round trips", "[json]" ) {
+  using namespace ivanp::hist;
+  const auto hs = json_test_hists();
+  const auto text = to_json(hs).dump();
+
+  const auto check = [&](const json_hists_t& rs) {
+    REQUIRE( to_json(rs).dump() == text );
+    REQUIRE( std::isnan(rs.at("b")->bin_at(4).w) );
+  };
+  // dense and sparse bins, with indices into the global axes and bins
+  for (const nlohmann::json& j : {
+    to_json(hs), nlohmann::json(as_sparse(hs))
+  }) {
+    json_hists_t a, b;
+    from_json(nlohmann::json::parse(j.dump()),a); // NaN parsed from null
+    read_json(j.dump(),b);
+    check(a);
+    check(b);
+  }
+
+  // a single histogram with "bins" before "axes"
+  const auto& h = *hs.at("c");
+  for (const nlohmann::json& j : {
+    nlohmann::json(h), nlohmann::json(as_sparse(h))
+  }) {
+    const auto s = R"({"bins":)"+j["bins"].dump()
+                 + R"(,"axes":)"+j["axes"].dump()+"}";
+    json_hist_t a, b;
+    from_json(nlohmann::json::parse(s),a);
+    read_json(s,b);
+    REQUIRE( nlohmann::json(a) == nlohmann::json(h) );
+    REQUIRE( nlohmann::json(b) == nlohmann::json(h) );
+  }
+}
+
+TEST_CASE( "binary round trips", "[binary]" ) {
+  using namespace ivanp::hist;
+  const auto hs = json_test_hists();
+  const auto path = temp_path("ivanp_hist_test.bin");
+  write_binary(path,hs);
+  {
+    const binary_file f(path);
+    REQUIRE( f.size() == hs.size() );
+    json_hists_t rs;
+    f.get(rs);
+    REQUIRE( to_json(rs).dump() == to_json(hs).dump() );
+
+    const auto& c = *hs.at("c");
+    const auto h = f.get<json_hist_t>("c");
+    REQUIRE( nlohmann::json(h) == nlohmann::json(c) );
+    // non-const views have read-only element access
+    auto v = f.get<histogram_view<
+      ww2_bin<double>, std::vector<uniform_axis<double>> >>("c");
+    REQUIRE( v.nbins() == c.nbins() );
+    REQUIRE( nlohmann::json(v.axes()) == nlohmann::json(c.axes()) );
+    for (index_type i=0; i<c.nbins(); ++i)
+      REQUIRE( v.bin_at(i).w == c.bin_at(i).w );
+    REQUIRE( v[{3,2}].w2 == c[{3,2}].w2 );
+    REQUIRE( v.find_bin(0.3,-0.5).w == c.find_bin(0.3,-0.5).w );
+  }
+
+  // corrupt header and index fields must be rejected
+  const std::string data = read_file(path);
+  const uint64_t index = [&]{
+    uint64_t x;
+    std::memcpy(&x, data.data()+24, sizeof(x));
+    return x;
+  }();
+  struct field { size_t off; uint64_t x; size_t size = 8; };
+  for (const field& f : {
+    field{  0, 0x5858585858585858 }, // magic
+    field{  8, 7, 4 },               // version
+    field{ 16, uint64_t(1) << 60 },  // number of histograms
+    field{ 24, data.size() },        // index offset
+    field{ 32, data.size()-2 },      // axes offset
+    field{ index+28, 0, 4 },         // bin size of the first histogram
+    field{ index+32, data.size() },  // its bins offset
+    field{ index+40, uint64_t(1) << 61 }, // its number of bins
+  }) {
+    std::string bad = data;
+    std::memcpy(bad.data()+f.off, &f.x, f.size);
+    write_file(path,bad);
+    REQUIRE_THROWS_AS( binary_file(path), std::invalid_argument );
+  }
+  // bins that do not match the axes
+  {
+    std::string bad = data;
+    const uint64_t nbins = 5;
+    std::memcpy(bad.data()+index+40, &nbins, sizeof(nbins));
+    write_file(path,bad);
+    const binary_file f(path);
+    REQUIRE_THROWS_AS( f.get<json_hist_t>(0), std::invalid_argument );
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE( "sparse json bins", "[json]" ) {
+  using namespace ivanp::hist;
+  using hist_t = histogram<double, axes_spec<std::vector<cont_axis<>>> >;
+  hist_t h(std::vector<cont_axis<>>{ {0,1,2,3,4,5,6,7,8} });
+  const auto sparse_bins = [](const hist_t& h) {
+    const nlohmann::json j = as_sparse(h);
+    REQUIRE( nlohmann::json::parse(write_json_string(as_sparse(h))) == j );
+    return j["bins"][1];
+  };
+
+  // all empty
+  REQUIRE( sparse_bins(h) == R"({"size":10,"runs":[]})"_json );
+
+  // runs at the first and the last bin,
+  // a single empty bin continues a run, two end it
+  for (const auto& [i, w] : { std::pair
+    {0,1.}, {1,2.}, {3,3.}, {6,4.}, {9,5.}
+  }) h.bin_at(i) = w;
+  REQUIRE( sparse_bins(h) == R"({"size":10,"runs":[
+    [0,[1.0,2.0,0.0,3.0]], [6,[4.0]], [9,[5.0]]
+  ]})"_json );
+
+  hist_t a, b;
+  from_json(nlohmann::json(as_sparse(h)),a);
+  read_json(write_json_string(as_sparse(h)),b);
+  REQUIRE( std::equal(a.begin(),a.end(),h.begin(),h.end()) );
+  REQUIRE( std::equal(b.begin(),b.end(),h.begin(),h.end()) );
+}
+
+TEST_CASE( "axis json round trips", "[json]" ) {
+  using namespace ivanp::hist;
+  const auto round_trip = [](const auto& a) {
+    const nlohmann::json j = a;
+    REQUIRE( write_json_string(a) == j.dump() );
+    using axis_t = std::decay_t<decltype(a)>;
+    axis_t b = nlohmann::json::parse(j.dump()).template get<axis_t>();
+    REQUIRE( nlohmann::json(b) == j );
+    REQUIRE( b.nbins() == a.nbins() );
+    for (index_type i=0; i<=a.nbins(); ++i)
+      REQUIRE( b.lower(i) == a.lower(i) );
+    return b;
+  };
+
+  const uniform_axis<double> u(0.5,2.5,8);
+  const log_uniform_axis<double> l(1,1000,30);
+  REQUIRE( nlohmann::json(u).dump() == "[[0.5,2.5,8]]" );
+  REQUIRE( nlohmann::json(l).dump() == R"([[1.0,1000.0,30,"log"]])" );
+  round_trip(u);
+  round_trip(l);
+
+  // every alternative is read back as itself
+  using var_t = variant_axis<
+    uniform_axis<double>, log_uniform_axis<double>,
+    transformed_axis<sqrt_transform>, cont_axis<>
+  >;
+  const var_t vs[] {
+    { std::in_place_index<0>, 0, 1, 10 },
+    { std::in_place_index<1>, 1, 1e4, 40 },
+    { std::in_place_index<2>, 0, 100, 20 },
+    { std::in_place_index<3>, std::vector<double>{ 0, 1, 2, 3 } },
+  };
+  for (const auto& v : vs)
+    REQUIRE( (*round_trip(v)).index() == (*v).index() );
+}
+
+TEST_CASE( "delta checkpoints", "[binary]" ) {
+  using namespace ivanp::hist;
+  using axes_t = std::vector<uniform_axis<double>>;
+  using hist_t = histogram<ww2_bin<double>, axes_spec<axes_t>,
+    bins_spec< tracked_bins<ww2_bin<double>,4> > >;
+  using hists_t = std::map<std::string,std::unique_ptr<hist_t>>;
+  hists_t hs;
+  auto& a = *(hs["a"] = std::make_unique<hist_t>(axes_t{{0,1,40}}));
+  auto& b = *(hs["b"] = std::make_unique<hist_t>(axes_t{{0,1,10},{-1,1,4}}));
+
+  const std::vector<std::string> deltas {
+    temp_path("ivanp_hist_test.0.bin"),
+    temp_path("ivanp_hist_test.1.bin"),
+    temp_path("ivanp_hist_test.2.bin")
+  };
+  const auto compact = temp_path("ivanp_hist_test.compact.bin"),
+             full = temp_path("ivanp_hist_test.full.bin");
+
+  for (int i=0; i<100; ++i) {
+    a({i*0.01},0.5);
+    b({i*0.01,i*0.02-1});
+  }
+  write_binary_delta(deltas[0],hs);
+  a({0.05},2.);
+  a({0.95},3.);
+  write_binary_delta(deltas[1],hs);
+  b({0.45,0.1},4.);
+  write_binary_delta(deltas[2],hs);
+
+  REQUIRE( binary_file(deltas[0]).size() == 2 );
+  REQUIRE( binary_file(deltas[1]).size() == 1 ); // b did not change
+  REQUIRE( binary_file(deltas[1]).delta() );
+  REQUIRE( read_file(deltas[1]).size() < read_file(deltas[0]).size() );
+
+  compact_binary<hists_t>(deltas,compact);
+  write_binary(full,hs);
+  REQUIRE( read_file(compact) == read_file(full) );
+
+  hists_t rs;
+  binary_file(compact).get(rs);
+  for (const auto& [name, h] : hs) {
+    const auto& r = *rs.at(name);
+    REQUIRE( r.nbins() == h->nbins() );
+    for (index_type i=0; i<h->nbins(); ++i) {
+      REQUIRE( r.bin_at(i).w  == h->bin_at(i).w  );
+      REQUIRE( r.bin_at(i).w2 == h->bin_at(i).w2 );
+    }
+  }
+
+  for (const auto& path : deltas) std::filesystem::remove(path);
+  std::filesystem::remove(compact);
+  std::filesystem::remove(full);
+}
+
+TEST_CASE( "merging json files", "[json]" ) {
+  using namespace ivanp::hist;
+  const auto hs1 = json_test_hists(), hs2 = json_test_hists();
+  hs2.at("a")->fill({0.75},1.5);
+  hs2.at("d")->fill({2.5},0.25);
+  const std::vector<std::string> paths {
+    temp_path("ivanp_hist_test.dense.json"),
+    temp_path("ivanp_hist_test.sparse.json")
+  };
+  write_file(paths[0],write_json_string(hs1));
+  write_file(paths[1],write_json_string(as_sparse(hs2)));
+
+  json_hists_t sum = json_test_hists();
+  for (const auto& [name, h] : sum)
+    for (index_type i=0; i<h->nbins(); ++i)
+      h->bin_at(i) += hs2.at(name)->bin_at(i);
+
+  for (const bool sparse : { false, true }) {
+    std::string out;
+    { json_writer w(out);
+      merge_json(paths,w,{ .threads = 2, .chunk = 7, .sparse = sparse });
+    }
+    json_hists_t rs;
+    read_json(out,rs);
+    REQUIRE( to_json(rs).dump() == to_json(sum).dump() );
+  }
+
+  // a histogram with different axes
+  auto hs3 = json_test_hists();
+  hs3["a"] = std::make_unique<json_hist_t>(
+    std::vector<uniform_axis<double>>{{0,2,10}} );
+  write_file(paths[1],write_json_string(hs3));
+  std::string out;
+  json_writer w(out);
+  REQUIRE_THROWS_AS( merge_json(paths,w), std::invalid_argument );
+
+  for (const auto& path : paths) std::filesystem::remove(path);
+}
+
+TEST_CASE( "parallel json writer", "[json]" ) {
+  using namespace ivanp::hist;
+  auto hs = json_test_hists();
+  for (index_type k=0; k<40; ++k) { // more histograms than threads
+    auto& h = *(hs["e"+std::to_string(k)] = std::make_unique<json_hist_t>(
+      std::vector<uniform_axis<double>>{{0,1,10+k}} ));
+    for (index_type i=0; i<k; ++i) h({i*0.03},0.5*i);
+  }
+  const auto write = [&](const auto& x, unsigned threads, size_t queued) {
+    std::string s;
+    { json_writer w(s);
+      write_json_parallel(w,x,threads,queued);
+    }
+    return s;
+  };
+  const auto dense = write_json_string(hs),
+             sparse = write_json_string(as_sparse(hs));
+  // without a limit, and with at most one queued text
+  for (size_t queued : { size_t(1) << 26, size_t(1) }) {
+    for (unsigned threads : { 1u, 4u, 0u }) {
+      REQUIRE( write(hs,threads,queued) == dense );
+      REQUIRE( write(as_sparse(hs),threads,queued) == sparse );
+    }
+  }
+}
+
+TEST_CASE( "compressed bins", "[binary]" ) {
+  using namespace ivanp::hist;
+  using detail::compress_block, detail::decompress_block;
+  const auto round_trip = [](const std::vector<double>& xs) {
+    std::string packed;
+    compress_block(reinterpret_cast<const char*>(xs.data()),
+      xs.size(), sizeof(double), packed);
+    std::vector<double> ys(xs.size());
+    decompress_block(packed.data(), packed.size(),
+      reinterpret_cast<char*>(ys.data()), ys.size(), sizeof(double));
+    REQUIRE( std::memcmp(xs.data(),ys.data(),xs.size()*sizeof(double)) == 0 );
+    return packed;
+  };
+
+  // empty
+  REQUIRE( round_trip({}).size() == 1 );
+  // incompressible, stored as is
+  std::vector<double> noise(1000);
+  std::mt19937_64 gen;
+  for (auto& x : noise) {
+    const uint64_t r = gen();
+    std::memcpy(&x,&r,sizeof(x));
+  }
+  const auto stored = round_trip(noise);
+  REQUIRE( stored[0] == char(detail::block_stored) );
+  REQUIRE( stored.size() == 1 + noise.size()*sizeof(double) );
+  // highly repetitive, with matches longer than the length extensions
+  std::vector<double> smooth(8192);
+  for (size_t i=0; i<smooth.size(); ++i) smooth[i] = i/64;
+  const auto packed = round_trip(smooth);
+  REQUIRE( packed[0] == char(detail::block_lz) );
+  REQUIRE( packed.size() < smooth.size() );
+
+  // truncated or corrupt blocks
+  const auto bad = [&](std::string_view p) {
+    std::vector<double> ys(smooth.size());
+    REQUIRE_THROWS_AS( decompress_block(p.data(), p.size(),
+      reinterpret_cast<char*>(ys.data()), ys.size(), sizeof(double)),
+      std::invalid_argument );
+  };
+  bad({});
+  bad(std::string_view(packed).substr(0,packed.size()-1));
+  bad(std::string_view(packed).substr(0,packed.size()/2));
+  bad(stored); // stored block of a different size
+  std::string p = packed;
+  p[0] = 7; // unknown method
+  bad(p);
+  p = packed;
+  p.append("\x00\x01\x00",3); // a match past the end of the bins
+  bad(p);
+  p = packed;
+  p[1] = char(0xF0); // more literals than there are
+  p[2] = char(0xFF);
+  bad(p);
+
+  // histograms with several blocks, decompressed in parallel
+  auto hs = json_test_hists();
+  auto& big = *(hs["big"] = std::make_unique<json_hist_t>(
+    std::vector<uniform_axis<double>>{{0,1,30000}} ));
+  for (int i=0; i<100000; ++i) big({(i%997)/997.},0.25*(i%7));
+  const auto path = temp_path("ivanp_hist_test.cmp.bin"),
+             plain = temp_path("ivanp_hist_test.bin");
+  write_binary_compressed(path,hs,2);
+  write_binary(plain,hs);
+  REQUIRE( read_file(path).size() < read_file(plain).size() );
+  for (unsigned threads : { 1u, 0u }) {
+    binary_file f(path);
+    REQUIRE( f.compressed() );
+    json_hists_t rs;
+    f.threads(threads).get(rs);
+    REQUIRE( to_json(rs).dump() == to_json(hs).dump() );
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(plain);
+}
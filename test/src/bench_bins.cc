@@ -0,0 +1,72 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include <ivanp/hist/bins.hh>
+
+using std::cout;
+using std::endl;
+using namespace ivanp::hist;
+
+template <typename F>
+double bench(const char* name, unsigned nrep, F&& f) {
+  using clock = std::chrono::steady_clock;
+  const auto t0 = clock::now();
+  double w = 0;
+  for (unsigned i=0; i<nrep; ++i) w = f();
+  const std::chrono::duration<double,std::nano> dt = clock::now() - t0;
+  cout << std::setw(28) << std::left << name
+       << std::setw(10) << std::right << std::fixed << std::setprecision(3)
+       << dt.count()/nrep << " ns/rep   w = "
+       << std::setprecision(17) << std::scientific << w << endl;
+  return w;
+}
+
+int main(int argc, char* argv[]) {
+  const unsigned n = 1 << 20, nrep = 50;
+
+  // many small weights added to a large total
+  std::vector<double> ws(n);
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<double> dist(0,1e-3);
+  for (auto& w : ws) w = dist(gen);
+  ws[0] = 1e10;
+
+  bench("ww2_bin<double> +=", nrep, [&]{
+    ww2_bin<double> b;
+    for (double w : ws) b += w;
+    return b.w;
+  });
+  bench("ww2_bin<double> accumulate", nrep, [&]{
+    ww2_bin<double> b;
+    b.accumulate(ws);
+    return b.w;
+  });
+  bench("ww2_bin<long double> +=", nrep, [&]{
+    ww2_bin<long double> b;
+    for (double w : ws) b += w;
+    return double(b.w);
+  });
+  bench("compensated_ww2_bin +=", nrep, [&]{
+    compensated_ww2_bin<double> b;
+    for (double w : ws) b += w;
+    return b.w.value();
+  });
+  bench("compensated_ww2_bin accum", nrep, [&]{
+    compensated_ww2_bin<double> b;
+    b.accumulate(ws);
+    return b.w.value();
+  });
+  bench("mc_bin accumulate", nrep, [&]{
+    mc_bin<double> b;
+    b.accumulate(ws);
+    return b.w;
+  });
+  bench("compensated_mc_bin accum", nrep, [&]{
+    compensated_mc_bin<double> b;
+    b.accumulate(ws);
+    return b.w.value();
+  });
+}
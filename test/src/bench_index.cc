@@ -0,0 +1,84 @@
+// Cost of the index type on the fill path.
+// Built twice, as bench_index32 and bench_index64,
+// with IVANP_HIST_INDEX_TYPE set to a 32 and a 64 bit type.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <span>
+#include <random>
+#include <chrono>
+
+#include <ivanp/hist/histograms.hh>
+
+using std::cout;
+using std::endl;
+using namespace ivanp::hist;
+
+template <typename F>
+double bench(const char* name, unsigned nrep, F&& f) {
+  using clock = std::chrono::steady_clock;
+  const auto t0 = clock::now();
+  double w = 0;
+  for (unsigned i=0; i<nrep; ++i) w = f();
+  const std::chrono::duration<double,std::nano> dt = clock::now() - t0;
+  cout << std::setw(28) << std::left << name
+       << std::setw(10) << std::right << std::fixed << std::setprecision(3)
+       << dt.count()/nrep << " ns/rep   w = "
+       << std::setprecision(17) << std::scientific << w << endl;
+  return w;
+}
+
+int main(int argc, char* argv[]) {
+  const unsigned n = 1 << 20, nrep = 20;
+  cout << "index_type: " << sizeof(index_type)*8 << " bit" << endl;
+
+  std::vector<double> xs(n), ys(n), zs(n);
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<double> dist(-0.1,1.1);
+  for (auto* v : { &xs, &ys, &zs })
+    for (auto& x : *v) x = dist(gen);
+
+  using uni_t = std::tuple<
+    uniform_axis<double>, uniform_axis<double>, uniform_axis<double> >;
+  histogram<double, axes_spec<uni_t>> hu(std::make_tuple(
+    uniform_axis<double>(0,1,100),
+    uniform_axis<double>(0,1,100),
+    uniform_axis<double>(0,1,100)
+  ));
+  std::vector<double> edges;
+  for (unsigned i=0; i<=100; ++i) edges.push_back(i*0.01);
+  using cont_t = std::tuple< cont_axis<>, cont_axis<>, cont_axis<> >;
+  histogram<double, axes_spec<cont_t>> hc(std::make_tuple(
+    cont_axis<>(edges), cont_axis<>(edges), cont_axis<>(edges)
+  ));
+
+  bench("3d uniform fill", nrep, [&]{
+    for (unsigned i=0; i<n; ++i) hu(xs[i],ys[i],zs[i]);
+    return hu.bin_at(hu.nbins()/2);
+  });
+  bench("3d cont fill", nrep, [&]{
+    for (unsigned i=0; i<n; ++i) hc(xs[i],ys[i],zs[i]);
+    return hc.bin_at(hc.nbins()/2);
+  });
+
+  const std::array<std::span<const double>,3> cols { xs, ys, zs };
+  std::vector<index_type> ii(n);
+  bench("3d uniform batch fill", nrep, [&]{
+    hu.find_bin_indices(cols,ii);
+    for (index_type i : ii) ++hu.bin_at(i);
+    return hu.bin_at(hu.nbins()/2);
+  });
+  bench("3d cont batch fill", nrep, [&]{
+    hc.find_bin_indices(cols,ii);
+    for (index_type i : ii) ++hc.bin_at(i);
+    return hc.bin_at(hc.nbins()/2);
+  });
+  bench("join_index", nrep, [&]{
+    double w = 0;
+    for (unsigned i=0; i<n; ++i)
+      w += hu.join_index(i%102, (i>>7)%102, (i>>14)%102);
+    return w;
+  });
+}
@@ -0,0 +1,71 @@
+// Sums histogram files in the JSON format of README.md
+//
+// usage: merge [-j threads] [-s] [-o output] input...
+//   -j  number of threads, all cores by default
+//   -s  write the sparse form of the bins
+//   -o  output file, stdout by default
+// An input @list is a file with an input path on every line.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <charconv>
+
+#include <ivanp/hist/histograms.hh>
+#include <ivanp/hist/merge.hh>
+
+using namespace ivanp::hist;
+
+int main(int argc, char* argv[]) {
+  merge_options opt;
+  const char* output = nullptr;
+  std::vector<std::string> inputs;
+
+  const auto usage = [&]{
+    std::cerr << "usage: " << argv[0]
+              << " [-j threads] [-s] [-o output] input...\n";
+    return 1;
+  };
+
+  for (int i=1; i<argc; ++i) {
+    const char* arg = argv[i];
+    if (!std::strcmp(arg,"-s")) opt.sparse = true;
+    else if (!std::strcmp(arg,"-j") && i+1 < argc) {
+      const char* x = argv[++i];
+      const char* end = x + std::strlen(x);
+      const auto [p, ec] = std::from_chars(x,end,opt.threads);
+      if (ec != std::errc() || p != end) return usage();
+    } else if (!std::strcmp(arg,"-o") && i+1 < argc)
+      output = argv[++i];
+    else if (arg[0] == '@') {
+      std::ifstream list(arg+1);
+      if (!list) {
+        std::cerr << "cannot open " << (arg+1) << '\n';
+        return 1;
+      }
+      for (std::string path; std::getline(list,path); )
+        if (!path.empty()) inputs.push_back(std::move(path));
+    } else if (arg[0] == '-' && arg[1]) return usage();
+    else inputs.emplace_back(arg);
+  }
+
+  try {
+    if (output) {
+      std::ofstream out(output);
+      if (!out) throw std::runtime_error(
+        std::string("cannot open ")+output);
+      json_writer w(out);
+      merge_json(inputs,w,opt);
+      w.put('\n').flush();
+    } else {
+      json_writer w(1);
+      merge_json(inputs,w,opt);
+      w.put('\n').flush();
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+}